@@ -7,6 +7,9 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
     j = jibal_init(nullptr);
+    if(j->gsto) {
+        j->gsto->lazy = TRUE; /* Stopping is loaded when it is used for the first time */
+    }
     incident = nullptr;
     layer.material = nullptr;
     layer.thickness = 2000.0*C_TFU;
@@ -73,7 +76,7 @@ void MainWindow::loadGsto()
         return;
     jibal_gsto_auto_assign_material(j->gsto, incident, layer.material);
     jibal_gsto_print_assignments(j->gsto);
-    jibal_gsto_load_all(j->gsto); /* TODO: calling this might not be necessary always. */
+    /* Data is loaded on first use (lazy mode), only the combinations that are needed */
 }
 
 void MainWindow::recalculate()
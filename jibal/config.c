@@ -49,10 +49,20 @@ jibal_config_var *make_config_vars(jibal_config *config) { /* Makes a structure
             {JIBAL_CONFIG_VAR_PATH,   "userdatadir",       0, 0, &config->userdatadir,      NULL, "GSTO data directory (user)"},
             {JIBAL_CONFIG_VAR_PATH,   "masses_file",       0, 0, &config->masses_file,      NULL, "Atomic masses files" },
             {JIBAL_CONFIG_VAR_PATH,   "abundances_file",   0, 0, &config->abundances_file,  NULL, "Isotopic abundances files"},
+            {JIBAL_CONFIG_VAR_BOOL,   "masses_cache",      0, 0, &config->masses_cache,     NULL, "Cache masses and abundances in a binary file in the user data directory"},
             {JIBAL_CONFIG_VAR_PATH,   "files_file",        0, 0, &config->files_file,       NULL, "GSTO stopping files file"},
             {JIBAL_CONFIG_VAR_PATH,   "assignments_file",  0, 0, &config->assignments_file, NULL, "GSTO stopping assignments file"},
+            {JIBAL_CONFIG_VAR_BOOL,   "gsto_manifest",     0, 0, &config->gsto_manifest,    NULL, "Cache headers of GSTO files in a binary file in the user data directory"},
             {JIBAL_CONFIG_VAR_INT,    "Z_max",             0, 0, &config->Z_max,            NULL, "Maximum element number (Z)"},
             {JIBAL_CONFIG_VAR_BOOL,   "extrapolate",       0, 0, &config->extrapolate,      NULL, "Extrapolate stopping"},
+            {JIBAL_CONFIG_VAR_DOUBLE, "stop_tolerance",    0, 0, &config->stop_tolerance,   NULL, "Relative tolerance of adaptive step in energy loss (0 = fixed step)"},
+            {JIBAL_CONFIG_VAR_BOOL,   "lazy_loading",      0, 0, &config->lazy_loading,     NULL, "Assign and load stopping automatically on first use"},
+            {JIBAL_CONFIG_VAR_BOOL,   "index_files",       0, 0, &config->index_files,      NULL, "Write index files next to ASCII stopping files"},
+            {JIBAL_CONFIG_VAR_INT,    "load_threads",      0, 0, &config->load_threads,     NULL, "Number of threads used to load stopping files"},
+            {JIBAL_CONFIG_VAR_INT,    "resample",          0, 0, &config->resample,         NULL, "Resample stopping to a uniform log grid, points per decade (0 = no resampling)"},
+            {JIBAL_CONFIG_VAR_DOUBLE, "resample_tolerance", 0, 0, &config->resample_tolerance, NULL, "Largest relative error of resampled stopping, combinations with larger errors are not resampled (0 = no limit)"},
+            {JIBAL_CONFIG_VAR_BOOL,   "single_precision",  0, 0, &config->single_precision, NULL, "Store stopping data in single precision"},
+            {JIBAL_CONFIG_VAR_BOOL,   "interleave",        0, 0, &config->interleave,       NULL, "Store stopping data interleaved with energies and slopes"},
             {JIBAL_CONFIG_VAR_OPTION, "rbs_cross_section", 0, 0, &config->cs_rbs, jibal_cs_types, "RBS cross section default"},
             {JIBAL_CONFIG_VAR_OPTION, "erd_cross_section", 0, 0, &config->cs_erd, jibal_cs_types, "ERD cross section default"},
             {0,                       0,                   0, 0, NULL,                      NULL, NULL}
@@ -248,7 +258,7 @@ char *jibal_config_user_config_filename() {
 }
 
 jibal_config jibal_config_defaults() {
-    jibal_config config = {.Z_max = JIBAL_MAX_Z, .extrapolate = FALSE, .error = 0, .config_file = NULL, .cs_rbs = JIBAL_CS_ANDERSEN, .cs_erd = JIBAL_CS_ANDERSEN};
+    jibal_config config = {.Z_max = JIBAL_MAX_Z, .extrapolate = FALSE, .stop_tolerance = 0.0, .lazy_loading = FALSE, .index_files = FALSE, .masses_cache = TRUE, .gsto_manifest = TRUE, .load_threads = 1, .resample = 0, .resample_tolerance = JIBAL_RESAMPLE_TOLERANCE, .single_precision = FALSE, .interleave = FALSE, .error = 0, .config_file = NULL, .cs_rbs = JIBAL_CS_ANDERSEN, .cs_erd = JIBAL_CS_ANDERSEN};
     const char *c=getenv("JIBAL_DATADIR");
     if(c) {
         config.datadir=strdup(c);
@@ -388,6 +398,8 @@ jibal_config *jibal_config_init(const jibal_units *units, const char *filename,
 }
 
 void jibal_config_free(jibal_config *config) {
+    if(!config)
+        return;
     free(config->config_file);
     free(config->datadir);
     free(config->userdatadir);
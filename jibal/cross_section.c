@@ -2,6 +2,8 @@
 #include <jibal_units.h>
 #include <jibal_phys.h>
 
+extern inline double jibal_cross_section_get(const jibal_cross_section *cs, double E);
+
 double jibal_cross_section_rbs(const jibal_isotope *incident, const jibal_isotope *target, double theta, double E, jibal_cross_section_type type) {
     double E_cm = target->mass*E/(incident->mass + target->mass);
     double r = incident->mass/target->mass;
@@ -34,12 +36,51 @@ double jibal_cross_section_erd(const jibal_isotope *incident, const jibal_isotop
     }
 }
 
+static double jibal_andersen_a(int z1, int z2, double E_cm_factor) {
+    return 48.73 * C_EV * z1 * z2 * sqrt(pow(z1, 2.0 / 3.0) + pow(z2, 2.0 / 3.0)) / E_cm_factor;
+}
+
+int jibal_cross_section_rbs_init(jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double theta, jibal_cross_section_type type) {
+    double r = incident->mass/target->mass;
+    cs->type = type;
+    cs->incident = incident;
+    cs->target = target;
+    cs->angle = theta;
+    cs->E_cm_factor = target->mass/(incident->mass + target->mass);
+    cs->theta_cm = theta + asin(r*sin(theta));
+    cs->sigma_factor = pow2((incident->Z*C_E*target->Z*C_E)/(4.0*C_PI*C_EPSILON0))*pow2(1.0/(4.0*cs->E_cm_factor))*pow4(1.0/sin(cs->theta_cm/2.0))
+            * pow((1.0 + pow2(r) + 2.0 * r * cos(cs->theta_cm)), 3.0/2.0)/(1.0 + r * cos(cs->theta_cm));
+    cs->andersen_a = jibal_andersen_a(incident->Z, target->Z, cs->E_cm_factor);
+    cs->andersen_b = 0.5/sin(cs->theta_cm/2.0);
+    return r < 1.0 || (theta < C_PI/2.0 && r*sin(theta) < 1.0); /* When incident is not lighter than target, theta must be below the maximum scattering angle */
+}
+
+int jibal_cross_section_erd_init(jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double phi, jibal_cross_section_type type) {
+    cs->type = type;
+    cs->incident = incident;
+    cs->target = target;
+    cs->angle = phi;
+    cs->E_cm_factor = target->mass/(incident->mass + target->mass);
+    cs->theta_cm = C_PI - 2 * phi;
+    cs->sigma_factor = pow2(incident->Z*C_E*target->Z*C_E/(8*C_PI*C_EPSILON0))
+            * pow2(1.0 + incident->mass/target->mass) * pow(cos(phi), -3.0);
+    cs->andersen_a = jibal_andersen_a(incident->Z, target->Z, cs->E_cm_factor);
+    cs->andersen_b = 0.5/sin(cs->theta_cm/2.0);
+    return cos(phi) > 0.0;
+}
+
+void jibal_cross_section_get_many(const jibal_cross_section *cs, const double *E, double *sigma, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        sigma[i] = jibal_cross_section_get(cs, E[i]);
+    }
+}
+
 const char *jibal_cross_section_name(jibal_cross_section_type type) {
     return jibal_option_get_string(jibal_cs_types, type);
 }
 
 double jibal_andersen_correction(int z1, int z2, double E_cm, double theta_cm) {
-    double r_VE = 48.73 * C_EV * z1 * z2 * sqrt(pow(z1, 2.0 / 3.0) + pow(z2, 2.0 / 3.0)) / E_cm;
+    double r_VE = jibal_andersen_a(z1, z2, 1.0) / E_cm;
     double F = pow2(1 + 0.5 * r_VE) / pow2(1 + r_VE + pow2(0.5 * r_VE / (sin(theta_cm / 2.0))));
     return F;
 }
@@ -7,6 +7,14 @@ double jibal_cs_erd(const jibal_config *config, const jibal_isotope *incident, c
     return jibal_cross_section_erd(incident, target, phi, E, config->cs_erd);
 }
 
+int jibal_cs_rbs_init(const jibal_config *config, jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double theta) {
+    return jibal_cross_section_rbs_init(cs, incident, target, theta, config->cs_rbs);
+}
+
+int jibal_cs_erd_init(const jibal_config *config, jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double phi) {
+    return jibal_cross_section_erd_init(cs, incident, target, phi, config->cs_erd);
+}
+
 const char *jibal_cs_rbs_name(const jibal_config *config) {
     return jibal_cross_section_name(config->cs_rbs);
 }
@@ -1,5 +1,21 @@
+#define _POSIX_C_SOURCE 200809L /* fdopen() */
 #include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <locale.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#define fdopen _fdopen
+#define close _close
+#else
+#include <unistd.h>
+#endif
 #include "jibal_generic.h"
+#include "thread_compat.h"
 
 int jibal_isdigit(const char c) {
     if(c >= '0' && c <= '9')
@@ -31,6 +47,41 @@ void jibal_fclose(FILE *f) {
     fclose(f);
 }
 
+FILE *jibal_fopen_tmp(const char *filename, char **filename_tmp) {
+    static size_t counter = 0; /* O_EXCL makes sure that a name is not used twice, counter only avoids collisions */
+    size_t len = strlen(filename) + 48;
+    char *name = malloc(len);
+    if(!name) {
+        return NULL;
+    }
+    int attempt;
+    for(attempt = 0; attempt < JIBAL_FOPEN_TMP_ATTEMPTS; attempt++) {
+#ifdef WIN32
+        snprintf(name, len, "%s.%d.%zu.tmp", filename, _getpid(), jibal_atomic_add_size(&counter, 1));
+        int fd = _open(name, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        snprintf(name, len, "%s.%ld.%zu.tmp", filename, (long)getpid(), jibal_atomic_add_size(&counter, 1));
+        int fd = open(name, O_WRONLY | O_CREAT | O_EXCL, 0666); /* Same permissions as fopen() */
+#endif
+        if(fd < 0) {
+            if(errno == EEXIST) {
+                continue;
+            }
+            break;
+        }
+        FILE *f = fdopen(fd, "wb");
+        if(!f) {
+            close(fd);
+            remove(name);
+            break;
+        }
+        *filename_tmp = name;
+        return f;
+    }
+    free(name);
+    return NULL;
+}
+
 char *jibal_remove_double_quotes(char *s) {
     char *src = s, *dst = s;
     while((*dst = *src) != '\0') {
@@ -101,3 +152,121 @@ char *jibal_strsep_with_quotes(char **stringp, const char *delim) {
         return s;
     }
 }
+
+static double strtod_c_locale(const char *nptr, char **endptr) { /* strtod(), but decimal point is always '.' */
+    const char *dp = localeconv()->decimal_point;
+    if(!dp || (dp[0] == '.' && dp[1] == '\0')) {
+        return strtod(nptr, endptr);
+    }
+    char buf[JIBAL_STRTOD_MAX_LENGTH + 8];
+    size_t dp_len = strlen(dp);
+    size_t n = 0, point = 0; /* point is the position of '.' in nptr, 0 if none */
+    const char *s;
+    for(s = nptr; *s && n + dp_len < JIBAL_STRTOD_MAX_LENGTH; s++) { /* Copy with '.' replaced by decimal point of locale */
+        if(*s == '.' && !point) {
+            point = (s - nptr) + 1;
+            memcpy(buf + n, dp, dp_len);
+            n += dp_len;
+        } else {
+            buf[n] = *s;
+            n++;
+        }
+    }
+    buf[n] = '\0';
+    char *end;
+    double x = strtod(buf, &end);
+    if(endptr) {
+        size_t consumed = end - buf;
+        if(point && consumed >= point - 1 + dp_len) {
+            consumed -= dp_len - 1;
+        } else if(point && consumed > point - 1) { /* Should not happen, decimal point was only partially consumed */
+            consumed = point - 1;
+        }
+        *endptr = (char *)nptr + consumed;
+    }
+    return x;
+}
+
+double jibal_strtod(const char *nptr, char **endptr) {
+    static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *s = nptr;
+    while(*s == ' ' || *s == '\t') {
+        s++;
+    }
+    int negative = (*s == '-');
+    if(*s == '-' || *s == '+') {
+        s++;
+    }
+    if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) { /* Hexadecimal */
+        return strtod_c_locale(nptr, endptr);
+    }
+    uint64_t mantissa = 0;
+    int n_digits = 0; /* Significant digits in mantissa */
+    int exponent = 0;
+    int any_digits = 0;
+    int truncated = 0;
+    for(; jibal_isdigit(*s); s++) {
+        any_digits = 1;
+        if(n_digits < 19) {
+            mantissa = 10 * mantissa + (*s - '0');
+            if(mantissa) {
+                n_digits++;
+            }
+        } else {
+            exponent++;
+            truncated = 1;
+        }
+    }
+    if(*s == '.') {
+        s++;
+        for(; jibal_isdigit(*s); s++) {
+            any_digits = 1;
+            if(n_digits < 19) {
+                mantissa = 10 * mantissa + (*s - '0');
+                if(mantissa) {
+                    n_digits++;
+                }
+                exponent--;
+            } else {
+                truncated = 1;
+            }
+        }
+    }
+    if(!any_digits) { /* inf, nan, hex or not a number at all. Let the C library deal with it. */
+        return strtod_c_locale(nptr, endptr);
+    }
+    if(*s == 'e' || *s == 'E') {
+        const char *e = s + 1;
+        int exp_negative = (*e == '-');
+        if(*e == '-' || *e == '+') {
+            e++;
+        }
+        if(jibal_isdigit(*e)) {
+            int exp_value = 0;
+            for(; jibal_isdigit(*e); e++) {
+                if(exp_value < 100000) {
+                    exp_value = 10 * exp_value + (*e - '0');
+                }
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+    if(endptr) {
+        *endptr = (char *)s;
+    }
+    if(mantissa == 0) {
+        return negative ? -0.0 : 0.0;
+    }
+    if(truncated || mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) { /* Result of fast path would not be correctly rounded */
+        return strtod_c_locale(nptr, endptr);
+    }
+    double x = (double)mantissa; /* Exact */
+    if(exponent < 0) {
+        x /= powers_of_ten[-exponent]; /* Both operands are exact, so the result is correctly rounded */
+    } else {
+        x *= powers_of_ten[exponent];
+    }
+    return negative ? -x : x;
+}
@@ -3,22 +3,29 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <inttypes.h>
 #include <jibal.h>
 #include <jibal_units.h>
 #include <jibal_phys.h>
 #include <jibal_gsto.h>
 #include <jibal_defaults.h>
 #include <jibal_config.h>
+#include <jibal_generic.h>
 #ifdef WIN32
 #include "win_compat.h"
 #else
 #include <libgen.h>
 #include <sys/param.h>
+#include <sys/mman.h>
 #endif
+#include <limits.h>
+#include <sys/stat.h>
 #include "jibal_stragg.h"
+#include "jibal_stop.h"
+#include "thread_compat.h"
 
 extern inline size_t jibal_gsto_table_get_index(const jibal_gsto *workspace, int Z1, int Z2);
-extern inline const double *jibal_gsto_file_get_data(const gsto_file_t *file, int Z1, int Z2);
+extern inline double jibal_gsto_cursor_data(const jibal_gsto_cursor *cursor, size_t i);
 
 const char *gsto_get_header_string(const jibal_option *header, int val) {
     const jibal_option *h;
@@ -38,6 +45,10 @@ int gsto_add_file(jibal_gsto *workspace, const char *name, const char *filename)
                 filename?filename:"unspecified location");
         return 0;
     }
+    if(workspace->parent || workspace->n_views) {
+        fprintf(stderr, "Can not add stopping file %s, files are shared with views (see jibal_gsto_view_new()).\n", name);
+        return 0;
+    }
 #ifdef DEBUG
     fprintf(stderr, "Adding file %s (%s).\n", name, filename);
 #endif
@@ -56,6 +67,7 @@ int gsto_add_file(jibal_gsto *workspace, const char *name, const char *filename)
     success=jibal_gsto_load(workspace, TRUE, new_file);
 
     if(success) {
+        new_file->lock = jibal_mutex_new();
         workspace->n_files++;
     } else {
         fprintf(stderr, "Error in adding stopping file %s (%s).\n", name, filename);
@@ -76,6 +88,27 @@ jibal_gsto *gsto_allocate(int Z1_max, int Z2_max) {
     workspace->stop_assignments = calloc(workspace->n_comb, sizeof(gsto_file_t *));
     workspace->stragg_assignments = calloc(workspace->n_comb, sizeof(gsto_file_t *));
     workspace->overrides = NULL;
+    workspace->rejected = NULL;
+    workspace->n_rejected = 0;
+    workspace->lazy = FALSE;
+    workspace->write_index = FALSE;
+    workspace->load_threads = 1;
+    workspace->parent = NULL;
+    workspace->n_views = 0;
+    workspace->views = NULL;
+    workspace->n_views_allocated = 0;
+    workspace->cache_budget = 0;
+    workspace->cache_hits = 0;
+    workspace->cache_misses = 0;
+    workspace->cache_evictions = 0;
+    workspace->cache_epoch = 0;
+    workspace->cache_loaded = 0;
+    workspace->cache_retired = NULL;
+    workspace->n_cache_retired = 0;
+    workspace->n_cache_retired_allocated = 0;
+    workspace->cache_pins = 0;
+    workspace->cache_active = SIZE_MAX;
+    workspace->lock = jibal_mutex_new();
     return workspace;
 }
 
@@ -83,17 +116,296 @@ const char *jibal_gsto_file_source(const gsto_file_t *file) {
     return file->source;
 }
 
-void jibal_gsto_file_free_data(gsto_file_t *file) {
+static void gsto_file_unmap(gsto_file_t *file) {
+    if(!file->map) {
+        return;
+    }
+#ifdef WIN32
+    free(file->map);
+#else
+    munmap(file->map, file->map_size);
+#endif
+    file->map = NULL;
+    file->map_size = 0;
+}
+
+typedef struct gsto_arena_block { /* Data of a file is allocated from a list of these, see gsto_arena_alloc() */
+    struct gsto_arena_block *next;
+    char *base; /* Aligned to GSTO_ARENA_ALIGN */
+    size_t size;
+    size_t used;
+} gsto_arena_block;
+
+static void *gsto_arena_alloc(gsto_file_t *file, size_t size) { /* Memory for data of file, aligned to a cache line. Blocks
+ * grow geometrically, so data of combinations loaded together is contiguous. Everything is released at once by
+ * gsto_arena_free(). Caller must hold file->lock. */
+    gsto_arena_block *block = file->arena;
+    size = (size + GSTO_ARENA_ALIGN - 1) / GSTO_ARENA_ALIGN * GSTO_ARENA_ALIGN;
+    if(!block || block->size - block->used < size) {
+        size_t block_size = block ? 2 * block->size : GSTO_ARENA_BLOCK_MIN * size;
+        if(block_size > GSTO_ARENA_BLOCK_MAX) {
+            block_size = GSTO_ARENA_BLOCK_MAX;
+        }
+        if(block_size < size) {
+            block_size = size;
+        }
+        gsto_arena_block *new_block = malloc(sizeof(gsto_arena_block) + GSTO_ARENA_ALIGN + block_size);
+        if(!new_block) {
+            return NULL;
+        }
+        new_block->next = block;
+        new_block->base = (char *)(((uintptr_t)(new_block + 1) + GSTO_ARENA_ALIGN - 1) & ~(uintptr_t)(GSTO_ARENA_ALIGN - 1));
+        new_block->size = block_size;
+        new_block->used = 0;
+        file->arena = new_block;
+        block = new_block;
+    }
+    void *out = block->base + block->used;
+    block->used += size;
+    return out;
+}
+
+static void gsto_arena_free(gsto_file_t *file) {
+    gsto_arena_block *block = file->arena;
+    while(block) {
+        gsto_arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    file->arena = NULL;
+}
+
+static size_t gsto_arena_size(const gsto_file_t *file) { /* Bytes allocated for the arena of file */
+    size_t size = 0;
+    const gsto_arena_block *block;
+    for(block = file->arena; block; block = block->next) {
+        size += block->size;
+    }
+    return size;
+}
+
+static void *gsto_file_alloc(gsto_file_t *file, size_t size) { /* Data of evictable files is allocated one combination at a time, so it can be freed (see gsto_file_evict()) */
+    return file->evictable ? malloc(size) : gsto_arena_alloc(file, size);
+}
+
+static void gsto_file_free_resampled(gsto_file_t *file) { /* Resampled data itself is in the arena */
+    free(file->rs_data);
+    file->rs_data = NULL;
+    free(file->rs_em);
+    file->rs_em = NULL;
+    file->rs_points = 0;
+    file->rs_error = 0.0;
+    file->rs_rejected = 0;
+}
+
+static void gsto_file_free_lookup(gsto_file_t *file) { /* Resampled and interleaved data. Data itself is freed only if the file is evictable, otherwise it stays in the arena. */
+    size_t i;
+    for(i = 0; file->evictable && i < file->n_comb; i++) {
+        if(file->rs_data) {
+            free(file->rs_data[i]);
+        }
+        if(file->il_data) {
+            free(file->il_data[i]);
+        }
+    }
+    gsto_file_free_resampled(file);
+    free(file->il_data);
+    file->il_data = NULL;
+}
+
+static inline double gsto_data_at(const double *data, int single, size_t i) { /* Point i of data, which is floats if single is TRUE */
+    return single ? ((const float *)data)[i] : data[i];
+}
+
+static inline const double *gsto_file_get_raw_data(const gsto_file_t *file, int Z1, int Z2) { /* Data as stored (floats if file->single is set). NULL if not loaded. */
+    return jibal_atomic_load_ptr(&file->data[jibal_gsto_file_get_data_index(file, Z1, Z2)]);
+}
+
+static void gsto_file_single_set_scale(gsto_file_t *file, size_t i_comb, const double *data) { /* Single precision data is scaled to avoid underflows (straggling in SI units is approximately 1e-46) */
+    double y_max = 0.0;
+    size_t i;
+    for(i = 0; i < file->xpoints; i++) {
+        y_max = fmax(y_max, fabs(data[i]));
+    }
+    file->single_scale[i_comb] = y_max > 0.0 ? y_max : 1.0;
+}
+
+static double *gsto_file_store(gsto_file_t *file, size_t i_comb, const double *data, size_t n) { /* Copies n points of data of
+ * combination i_comb to the arena, in single precision if file->single is set (returns floats then). Updates file->single_error. NULL if out of memory. */
+    if(!file->single) {
+        double *out = gsto_file_alloc(file, sizeof(double) * n);
+        if(!out) {
+            return NULL;
+        }
+        memcpy(out, data, sizeof(double) * n);
+        return out;
+    }
+    const double scale = file->single_scale[i_comb];
+    float *out = gsto_file_alloc(file, sizeof(float) * n);
+    if(!out) {
+        return NULL;
+    }
+    size_t i;
+    for(i = 0; i < n; i++) {
+        out[i] = (float)(data[i] / scale);
+        if(data[i] != 0.0) {
+            double err = fabs(out[i] * scale - data[i]) / fabs(data[i]);
+            if(err > file->single_error) {
+                file->single_error = err;
+            }
+        }
+    }
+    return (double *)out;
+}
+
+static double *gsto_file_data_copy(const gsto_file_t *file, size_t i_comb) { /* Data of a combination in double precision (also if file->single is set). Caller must free. NULL if not loaded or out of memory. */
+    const double *data = file->data ? file->data[i_comb] : NULL;
+    if(!data) {
+        return NULL;
+    }
+    double *out = malloc(sizeof(double) * file->xpoints);
+    if(!out) {
+        return NULL;
+    }
+    size_t i;
+    for(i = 0; i < file->xpoints; i++) {
+        out[i] = file->single ? file->single_scale[i_comb] * ((const float *)data)[i] : data[i];
+    }
+    return out;
+}
+
+static int gsto_file_resample_grid(gsto_file_t *file) { /* Makes the resampled grid (file->rs_em) from file->em, if file->resample is set */
+    if(file->rs_em) {
+        return 1;
+    }
+    if(file->resample <= 0 || !file->em || file->xpoints < 2) {
+        return 0;
+    }
+    double em_min = file->em[0], em_max = file->em[file->xpoints - 1];
+    if(!(em_min > 0.0 && em_max > em_min)) {
+        fprintf(stderr, "WARNING: Data of file %s can not be resampled to a log scale, it starts from zero energy.\n", file->name);
+        return 0;
+    }
+    size_t n = ceil(log10(em_max / em_min) * file->resample) + 1;
+    if(n < 2) {
+        n = 2;
+    }
+    file->rs_log_em_min = log(em_min);
+    file->rs_div = (n - 1) / (log(em_max) - file->rs_log_em_min);
+    file->rs_em = malloc(sizeof(double) * n);
     size_t i;
-    if(file->data) {
-        for(i = 0; i < file->n_comb; i++) {
-            if(file->data[i]) {
-                free(file->data[i]);
+    for(i = 0; i < n; i++) {
+        file->rs_em[i] = exp(file->rs_log_em_min + i / file->rs_div);
+    }
+    file->rs_em[0] = em_min; /* Exactly, so the range is the same */
+    file->rs_em[n - 1] = em_max;
+    file->rs_points = n;
+    file->rs_error = 0.0;
+    file->rs_rejected = 0;
+    file->rs_data = calloc(file->n_comb, sizeof(double *));
+    return 1;
+}
+
+static double *gsto_file_resample_data(const gsto_file_t *file, const double *data, double *error) { /* Returns data resampled to the grid
+ * file->rs_em (caller must free). The largest relative error (see GSTO_RESAMPLE_ERROR_FLOOR) is stored in error. */
+    const double *e = file->em, *rs_e = file->rs_em;
+    const size_t last = file->xpoints - 1, rs_last = file->rs_points - 1;
+    double *out = malloc(sizeof(double) * file->rs_points);
+    if(!out) {
+        return NULL;
+    }
+    size_t i, lo = 0;
+    for(i = 0; i < file->rs_points; i++) {
+        while(lo + 1 < last && rs_e[i] >= e[lo + 1]) {
+            lo++;
+        }
+        out[i] = jibal_linear_interpolation(e[lo], e[lo + 1], data[lo], data[lo + 1], rs_e[i]);
+    }
+    double y_max = 0.0;
+    for(i = 0; i < file->xpoints; i++) {
+        y_max = fmax(y_max, fabs(data[i]));
+    }
+    *error = 0.0;
+    if(y_max > 0.0) {
+        /* Both original and resampled data are linearly interpolated, so the largest difference is at the original points (points of the resampled grid are exact) */
+        for(i = 0, lo = 0; i < file->xpoints; i++) {
+            while(lo + 1 < rs_last && e[i] >= rs_e[lo + 1]) {
+                lo++;
             }
+            double y = jibal_linear_interpolation(rs_e[lo], rs_e[lo + 1], out[lo], out[lo + 1], e[i]);
+            double err = fabs(y - data[i]) / fmax(fabs(data[i]), GSTO_RESAMPLE_ERROR_FLOOR * y_max);
+            if(err > *error) {
+                *error = err;
+            }
+        }
+    }
+    return out;
+}
+
+static gsto_point *gsto_file_interleave_data(gsto_file_t *file, size_t i_comb, const double *em, const double *data, size_t n) { /* Interleaved copy
+ * of data in the arena. Values are divided by the scale of single precision data, so they can be used like single precision data. NULL if out of memory. */
+    gsto_point *out = gsto_file_alloc(file, sizeof(gsto_point) * n);
+    if(!out) {
+        return NULL;
+    }
+    const double scale = file->single ? file->single_scale[i_comb] : 1.0;
+    size_t i;
+    for(i = 0; i < n; i++) {
+        out[i].em = em[i];
+        out[i].y = data[i] / scale;
+        out[i].slope = (i + 1 < n) ? (data[i + 1] - data[i]) / scale / (em[i + 1] - em[i]) : 0.0;
+    }
+    return out;
+}
+
+static void gsto_file_store_lookup(gsto_file_t *file, size_t i_comb, const double *data) { /* Makes resampled and interleaved data of a
+ * combination, if they are used. Data (in double precision) is not modified. A combination is not resampled if the error
+ * would exceed file->rs_tolerance (or if we run out of memory), lookups and interleaved data then use the original grid.
+ * Caller must hold file->lock. */
+    const double *em = file->em;
+    size_t n = file->xpoints;
+    double *rs = NULL;
+    if(file->rs_data) {
+        double error = 0.0;
+        double *rs_stored = NULL;
+        rs = gsto_file_resample_data(file, data, &error);
+        if(rs && file->rs_tolerance > 0.0 && error > file->rs_tolerance) {
+            file->rs_rejected++;
+        } else if(rs) {
+            rs_stored = gsto_file_store(file, i_comb, rs, file->rs_points);
+        }
+        if(rs_stored) {
+            jibal_atomic_store_ptr(&file->rs_data[i_comb], rs_stored);
+            file->rs_error = fmax(file->rs_error, error);
+            em = file->rs_em;
+            data = rs;
+            n = file->rs_points;
+        } else {
+            free(rs);
+            rs = NULL;
         }
-        free(file->data);
-        file->data = NULL;
     }
+    if(file->il_data) {
+        jibal_atomic_store_ptr(&file->il_data[i_comb], gsto_file_interleave_data(file, i_comb, em, data, n));
+    }
+    free(rs);
+}
+
+void jibal_gsto_file_free_data(gsto_file_t *file) {
+    size_t i;
+    for(i = 0; file->evictable && file->data && i < file->n_comb; i++) {
+        free(file->data[i]);
+    }
+    free(file->data); /* Data itself is in the arena or mapped */
+    file->data = NULL;
+    gsto_file_free_lookup(file);
+    free(file->last_use);
+    file->last_use = NULL;
+    free(file->single_scale);
+    file->single_scale = NULL;
+    file->single_error = 0.0;
+    gsto_arena_free(file);
+    gsto_file_unmap(file);
 }
 
 void jibal_gsto_file_free(gsto_file_t *file) {
@@ -103,33 +415,105 @@ void jibal_gsto_file_free(gsto_file_t *file) {
     jibal_gsto_file_free_data(file);
     free(file->em);
     file->em = NULL;
+    free(file->offsets);
+    file->offsets = NULL;
+    file->n_indexed = 0;
     free(file->name);
     file->name = NULL;
     free(file->source);
     file->source = NULL;
     free(file->filename);
     file->filename = NULL;
+    jibal_mutex_free(file->lock);
+    file->lock = NULL;
 }
 
 void jibal_gsto_free(jibal_gsto *workspace) {
     if(!workspace)
         return;
     size_t i;
-    if(workspace->files) {
+    if(workspace->parent) { /* View, files belong to the parent */
+        jibal_gsto *database = workspace->parent;
+        jibal_mutex_lock(database->lock);
+        for(i = 0; i < database->n_views; i++) {
+            if(database->views[i] == workspace) {
+                database->views[i] = database->views[database->n_views - 1];
+                database->n_views--;
+                break;
+            }
+        }
+        jibal_mutex_unlock(database->lock);
+    } else if(workspace->files) {
+        if(workspace->n_views) {
+            fprintf(stderr, "WARNING: GSTO workspace freed while it still has %zu views.\n", workspace->n_views);
+        }
         for (i = 0; i < workspace->n_files; i++) {
             gsto_file_t *file = &workspace->files[i];
             jibal_gsto_file_free(file);
         }
         free(workspace->files);
     }
+    for(i = 0; i < workspace->n_cache_retired; i++) {
+        free(workspace->cache_retired[i].data);
+    }
+    free(workspace->cache_retired);
+    for(i = 0; i < workspace->n_rejected; i++) {
+        free(workspace->rejected[i]);
+    }
+    free(workspace->rejected);
+    free(workspace->views);
     free(workspace->stop_assignments);
     free(workspace->stragg_assignments);
     if(workspace->overrides) {
         free(workspace->overrides);
     }
+    jibal_mutex_free(workspace->lock);
     free(workspace);
 }
 
+jibal_gsto *jibal_gsto_view_new(const jibal_gsto *workspace) {
+    if(!workspace) {
+        return NULL;
+    }
+    jibal_gsto *database = workspace->parent ? workspace->parent : (jibal_gsto *) workspace; /* A view of a view is a view of the same database */
+    jibal_gsto *view = gsto_allocate(workspace->Z1_max, workspace->Z2_max);
+    view->elements = workspace->elements;
+    view->n_files = database->n_files;
+    view->files = database->files;
+    view->parent = database;
+    memcpy(view->stop_assignments, workspace->stop_assignments, sizeof(gsto_file_t *) * workspace->n_comb);
+    memcpy(view->stragg_assignments, workspace->stragg_assignments, sizeof(gsto_file_t *) * workspace->n_comb);
+    if(workspace->overrides) {
+        size_t n;
+        for(n = 0; workspace->overrides[n].file != NULL; n++) {}
+        view->overrides = malloc(sizeof(gsto_assignment) * (n + 1)); /* Including the terminating one */
+        memcpy(view->overrides, workspace->overrides, sizeof(gsto_assignment) * (n + 1));
+    }
+    view->stop_step = workspace->stop_step;
+    view->stop_tolerance = workspace->stop_tolerance;
+    view->extrapolate = workspace->extrapolate;
+    view->lazy = workspace->lazy;
+    view->write_index = workspace->write_index;
+    view->load_threads = workspace->load_threads;
+    jibal_mutex_lock(database->lock);
+    if(database->n_views == database->n_views_allocated) {
+        size_t n_alloc = database->n_views_allocated ? 2 * database->n_views_allocated : 8;
+        jibal_gsto **views = realloc(database->views, n_alloc * sizeof(jibal_gsto *));
+        if(!views) {
+            jibal_mutex_unlock(database->lock);
+            view->parent = NULL;
+            view->files = NULL; /* Not ours */
+            jibal_gsto_free(view);
+            return NULL;
+        }
+        database->views = views;
+        database->n_views_allocated = n_alloc;
+    }
+    database->views[database->n_views++] = view;
+    jibal_mutex_unlock(database->lock);
+    return view;
+}
+
 int jibal_gsto_file_has_combination(const gsto_file_t *file, int Z1, int Z2) {
     if(file->Z1_min == JIBAL_ANY_Z && file->Z2_min == JIBAL_ANY_Z) {
         return 1;
@@ -181,34 +565,229 @@ int jibal_gsto_assign_range(jibal_gsto *workspace, int Z1_min, int Z1_max, int Z
     return 1;
 }
 
+static void gsto_convert_data_to_SI(const gsto_file_t *file, int Z1, int Z2, double *data) { /* Data is converted if headers have been converted by jibal_gsto_convert_file_to_SI() */
+    size_t i;
+    if(file->stounit_original == GSTO_STO_UNIT_EV15CM2 && file->stounit == GSTO_STO_UNIT_JM2) {
+        for(i = 0; i < file->xpoints; i++) {
+            data[i] *= C_EV_TFU;
+        }
+    }
+    if(file->straggunit_original == GSTO_STRAGG_UNIT_BOHR && file->straggunit == GSTO_STRAGG_UNIT_J2M2) {
+        for(i = 0; i < file->xpoints; i++) {
+            data[i] *= jibal_stragg_bohr(Z1, Z2);
+        }
+    }
+}
+
+static int gsto_file_publish_data(gsto_file_t *file, int Z1, int Z2, double *data) { /* Data (of one combination) is
+ * converted, copied to the arena of the file and made visible to other threads. The caller keeps data (contents are
+ * converted). Caller must hold file->lock. Returns 0 if out of memory (nothing is published then). */
+    size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
+    gsto_convert_data_to_SI(file, Z1, Z2, data);
+    if(file->single) {
+        gsto_file_single_set_scale(file, i, data);
+    }
+    double *stored = gsto_file_store(file, i, data, file->xpoints);
+    if(!stored) {
+        fprintf(stderr, "ERROR: Out of memory, could not store Z1=%i Z2=%i of file %s.\n", Z1, Z2, file->name);
+        return 0;
+    }
+    gsto_file_store_lookup(file, i, data); /* Resampled and interleaved data is visible before data */
+    jibal_atomic_store_ptr(&file->data[i], stored);
+    return 1;
+}
+
 int jibal_gsto_load_binary_file(jibal_gsto *workspace, gsto_file_t *file) {
     int Z1, Z2;
 #ifdef DEBUG
     fprintf(stderr, "Loading binary data.\n");
 #endif
+    double *data = malloc(sizeof(double) * file->xpoints); /* Read buffer, published data is copied to the arena */
     for (Z1=file->Z1_min; Z1<=file->Z1_max; Z1++) {
         for (Z2=file->Z2_min; Z2<=file->Z2_max; Z2++) {
-            if (file == jibal_gsto_get_assigned_file(workspace, file->type, Z1, Z2)) { /* OK */
-                double *data = jibal_gsto_file_allocate_data(file, Z1, Z2);
-                if(!data) {
-                    file->valid = FALSE; /* Not really */
-                    return 0;
-                }
+            if (file == jibal_gsto_get_assigned_file(workspace, file->type, Z1, Z2) && !gsto_file_get_raw_data(file, Z1, Z2)) { /* Assigned and not loaded yet */
                 size_t n = fread(data, sizeof(double), file->xpoints, file->fp);
                 if(n != file->xpoints) {
+                    free(data);
                     file->valid=FALSE;
                     return 0;
                 }
+                if(!gsto_file_publish_data(file, Z1, Z2, data)) {
+                    free(data);
+                    return 0;
+                }
             } else {
                 if(fseek(file->fp, sizeof(double)*file->xpoints, SEEK_CUR)) {
+                    free(data);
                     file->valid=FALSE;
                     return 0;
                 }
             }
         }
     }
+    free(data);
+    return 1;
+}
+static uint64_t gsto_container_align(uint64_t offset) {
+    return (offset + GSTO_CONTAINER_ALIGN - 1) / GSTO_CONTAINER_ALIGN * GSTO_CONTAINER_ALIGN;
+}
+
+int jibal_gsto_load_container_file(jibal_gsto *workspace, gsto_file_t *file) {
+    (void) workspace; /* Everything is mapped, regardless of assignments. Pages are read from disk when they are used. */
+#ifdef DEBUG
+    fprintf(stderr, "Loading (mapping) container %s.\n", file->filename);
+#endif
+    if(file->map) { /* Already mapped, there is nothing more to load */
+        return 1;
+    }
+    if(file->stounit_original == GSTO_STO_UNIT_EV15CM2 || file->straggunit_original == GSTO_STRAGG_UNIT_BOHR) {
+        fprintf(stderr, "ERROR: Container file %s must be in SI units (sto-unit=Jm2 or stragg-unit=J2m2).\n", file->filename);
+        file->valid = FALSE;
+        return 0;
+    }
+    long pos = ftell(file->fp); /* End of headers (and x table) */
+    if(pos < 0 || fseek(file->fp, 0, SEEK_END)) {
+        file->valid = FALSE;
+        return 0;
+    }
+    long size = ftell(file->fp);
+    uint64_t header_offset = gsto_container_align(pos);
+    if(size < 0 || (uint64_t)size < header_offset + sizeof(gsto_container_header)) {
+        fprintf(stderr, "ERROR: Container file %s is truncated.\n", file->filename);
+        file->valid = FALSE;
+        return 0;
+    }
+#ifdef WIN32
+    file->map = malloc(size);
+    if(fseek(file->fp, 0, SEEK_SET) || fread(file->map, 1, size, file->fp) != (size_t)size) {
+        free(file->map);
+        file->map = NULL;
+    }
+#else
+    file->map = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(file->fp), 0);
+    if(file->map == MAP_FAILED) {
+        file->map = NULL;
+    }
+#endif
+    if(!file->map) {
+        fprintf(stderr, "ERROR: Could not map container file %s.\n", file->filename);
+        file->valid = FALSE;
+        return 0;
+    }
+    file->map_size = size;
+    const char *map = file->map;
+    const gsto_container_header *header = (const gsto_container_header *)(map + header_offset);
+    if(memcmp(header->magic, GSTO_CONTAINER_MAGIC, sizeof(header->magic)) != 0 || header->version != GSTO_CONTAINER_VERSION) {
+        fprintf(stderr, "ERROR: File %s is not a GSTO container (version %i).\n", file->filename, GSTO_CONTAINER_VERSION);
+        goto error;
+    }
+    if(header->endian_check != GSTO_CONTAINER_ENDIAN_CHECK) {
+        fprintf(stderr, "ERROR: Container file %s has been written on a machine with a different byte order.\n", file->filename);
+        goto error;
+    }
+    if(header->n_comb != file->n_comb || header->xpoints != file->xpoints) {
+        fprintf(stderr, "ERROR: Container file %s has %" PRIu64 " combinations of %" PRIu64 " points, headers say %zu and %zu.\n",
+                file->filename, header->n_comb, header->xpoints, file->n_comb, file->xpoints);
+        goto error;
+    }
+    uint64_t index_size = header->n_comb * sizeof(uint64_t); /* n_comb is known to be sane, no overflow */
+    uint64_t data_size = file->xpoints * sizeof(double);
+    if(header->index_offset % sizeof(uint64_t) || index_size > (uint64_t)size || header->index_offset > (uint64_t)size - index_size || data_size > (uint64_t)size) {
+        fprintf(stderr, "ERROR: Container file %s has an invalid index.\n", file->filename);
+        goto error;
+    }
+    const uint64_t *index = (const uint64_t *)(map + header->index_offset);
+    size_t i;
+    for(i = 0; i < file->n_comb; i++) {
+        if(index[i] == 0) { /* Not in the file */
+            continue;
+        }
+        if(index[i] % sizeof(double) || index[i] > (uint64_t)size - data_size) {
+            fprintf(stderr, "ERROR: Container file %s has an invalid offset for combination %zu.\n", file->filename, i);
+            goto error;
+        }
+        gsto_file_store_lookup(file, i, (const double *)(map + index[i]));
+        jibal_atomic_store_ptr(&file->data[i], (double *)(map + index[i]));
+    }
+    return 1;
+error:
+    for(i = 0; i < file->n_comb; i++) {
+        file->data[i] = NULL;
+    }
+    gsto_file_unmap(file);
+    file->valid = FALSE;
+    return 0;
+}
+
+static int gsto_fprint_padding(FILE *f, uint64_t n) { /* Returns 0 if writing fails */
+    while(n--) {
+        if(fputc(0, f) == EOF) {
+            return 0;
+        }
+    }
     return 1;
 }
+
+static int gsto_fprint_container(FILE *file_out, const jibal_gsto *workspace, const gsto_file_t *file, int Z1_min, int Z1_max, int Z2_min, int Z2_max) {
+    long pos = ftell(file_out);
+    if(pos < 0) {
+        fprintf(stderr, "Error: container format can only be written to a regular file.\n");
+        return 0;
+    }
+    gsto_file_t out; /* Used for the index, to get the same combinations as the headers (already written) say */
+    memset(&out, 0, sizeof(gsto_file_t));
+    out.Z1_min = Z1_min;
+    out.Z1_max = Z1_max;
+    out.Z2_min = Z2_min;
+    out.Z2_max = Z2_max;
+    jibal_gsto_file_calculate_ncombs(&out);
+    gsto_container_header header;
+    memset(&header, 0, sizeof(gsto_container_header));
+    memcpy(header.magic, GSTO_CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = GSTO_CONTAINER_VERSION;
+    header.endian_check = GSTO_CONTAINER_ENDIAN_CHECK;
+    header.n_comb = out.n_comb;
+    header.xpoints = file->xpoints;
+    uint64_t header_offset = gsto_container_align(pos);
+    header.index_offset = header_offset + sizeof(gsto_container_header);
+    header.payload_offset = gsto_container_align(header.index_offset + out.n_comb * sizeof(uint64_t));
+    uint64_t stride = gsto_container_align(file->xpoints * sizeof(double));
+    uint64_t *index = calloc(out.n_comb, sizeof(uint64_t));
+    if(!index) {
+        return 0;
+    }
+    uint64_t offset = header.payload_offset;
+    int Z1, Z2;
+    for(Z1 = Z1_min; Z1 <= Z1_max && Z1 <= workspace->Z1_max; Z1++) {
+        for(Z2 = Z2_min; Z2 <= Z2_max && Z2 <= workspace->Z2_max; Z2++) {
+            if(!gsto_file_get_raw_data(file, Z1, Z2)) {
+                fprintf(stderr, "Warning: no data for Z1=%i and Z2=%i in %s, it will not be in the container.\n", Z1, Z2, file->name);
+                continue;
+            }
+            index[jibal_gsto_file_get_data_index(&out, Z1, Z2)] = offset;
+            offset += stride;
+        }
+    }
+    header.payload_size = offset - header.payload_offset;
+    int success = gsto_fprint_padding(file_out, header_offset - pos) &&
+                  fwrite(&header, sizeof(gsto_container_header), 1, file_out) == 1 &&
+                  fwrite(index, sizeof(uint64_t), out.n_comb, file_out) == out.n_comb &&
+                  gsto_fprint_padding(file_out, header.payload_offset - (header.index_offset + out.n_comb * sizeof(uint64_t)));
+    for(Z1 = Z1_min; Z1 <= Z1_max && Z1 <= workspace->Z1_max && success; Z1++) {
+        for(Z2 = Z2_min; Z2 <= Z2_max && Z2 <= workspace->Z2_max && success; Z2++) {
+            if(!index[jibal_gsto_file_get_data_index(&out, Z1, Z2)]) { /* Only what is in the index, even if something was loaded in the meantime */
+                continue;
+            }
+            double *data = gsto_file_data_copy(file, jibal_gsto_file_get_data_index(file, Z1, Z2));
+            success = data && fwrite(data, sizeof(double), file->xpoints, file_out) == file->xpoints &&
+                      gsto_fprint_padding(file_out, stride - file->xpoints * sizeof(double));
+            free(data);
+        }
+    }
+    free(index);
+    return success;
+}
+
 void jibal_gsto_fprint_header_property(FILE *f, gsto_header_type h, int val) {
     const jibal_option *properties;
     switch(h) {
@@ -403,9 +982,15 @@ void jibal_gsto_fprint_file(FILE *file_out, const jibal_gsto *workspace, const g
         fprintf(stderr, "This file isn't loaded yet.\n");
         return;
     }
+    if(format == GSTO_DF_CONTAINER) {
+        if(!gsto_fprint_container(file_out, workspace, file, Z1_min, Z1_max, Z2_min, Z2_max)) {
+            fprintf(stderr, "Error: could not write container of %s.\n", file->name);
+        }
+        return;
+    }
     for (Z1=Z1_min; Z1 <= Z1_max  && Z1 <= workspace->Z1_max; Z1++) {
         for (Z2 = Z2_min; Z2 <= Z2_max && Z2 <= workspace->Z2_max; Z2++) {
-            const double *data = jibal_gsto_file_get_data(file, Z1, Z2);
+            double *data = gsto_file_data_copy(file, jibal_gsto_file_get_data_index(file, Z1, Z2));
             if(!data) {
                 fprintf(stderr, "Error: no data for Z1=%i and Z2=%i in %s.\n", Z1, Z2, file->name);
                 return;
@@ -433,6 +1018,7 @@ void jibal_gsto_fprint_file(FILE *file_out, const jibal_gsto *workspace, const g
             } else if(format == GSTO_DF_DOUBLE) {
                 fwrite(data, sizeof(double), file->xpoints, file_out);
             }
+            free(data);
         }
     }
 }
@@ -466,124 +1052,441 @@ size_t jibal_gsto_file_get_data_index(const gsto_file_t *file, int Z1, int Z2) {
 
 
 
+const double *jibal_gsto_file_get_data(const gsto_file_t *file, int Z1, int Z2) {
+    if(file->single) {
+        return NULL;
+    }
+    return gsto_file_get_raw_data(file, Z1, Z2);
+}
+
+const void *jibal_gsto_file_get_raw_data(const gsto_file_t *file, int Z1, int Z2) {
+    return gsto_file_get_raw_data(file, Z1, Z2);
+}
+
+double jibal_gsto_file_get_data_point(const gsto_file_t *file, int Z1, int Z2, size_t i) {
+    const double *data = gsto_file_get_raw_data(file, Z1, Z2);
+    if(!data || i >= file->xpoints) {
+        return 0.0;
+    }
+    if(file->single) {
+        return file->single_scale[jibal_gsto_file_get_data_index(file, Z1, Z2)] * gsto_data_at(data, TRUE, i);
+    }
+    return data[i];
+}
+
 double *jibal_gsto_file_allocate_data(gsto_file_t *file, int Z1, int Z2) {
     size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
     assert(i < file->n_comb);
-    free(file->data[i]);
-    file->data[i] = calloc(file->xpoints, sizeof(double));
+    if(file->single || file->map) { /* Allocated data is in double precision */
+        return NULL;
+    }
+    if(file->evictable) {
+        free(file->data[i]);
+    }
+    file->data[i] = gsto_file_alloc(file, sizeof(double) * file->xpoints); /* Previous data of an evictable file was freed above, otherwise it stays in the arena until the data is freed */
+    if(!file->data[i]) {
+        return NULL;
+    }
+    memset(file->data[i], 0, sizeof(double) * file->xpoints);
     return file->data[i];
 }
 
-int jibal_gsto_load_ascii_file(jibal_gsto *workspace, gsto_file_t *file) {
-    int Z1, Z2, previous_Z1=file->Z1_min, previous_Z2=file->Z2_min-1;
-    size_t skip, i;
-    char *line = NULL;
-    size_t line_size=0;
-    int actually_skipped=0;
-#ifdef DEBUG
-    fprintf(stderr, "Loading ascii data from file %s.\n", file->name);
-#endif
+typedef struct gsto_ascii_reader { /* Reads lines from file->fp in large blocks */
+    FILE *fp;
+    char *buf;
+    size_t size; /* Allocated size of buf (excluding the extra byte for '\0') */
+    size_t len; /* Number of bytes in buf */
+    size_t pos; /* Next line starts at buf + pos */
+    long buf_offset; /* File offset of buf[0] */
+    int eof;
+} gsto_ascii_reader;
 
-    for (Z1 = file->Z1_min; Z1 <= file->Z1_max && Z1 <= workspace->Z1_max; Z1++) {
-        for (Z2 = file->Z2_min; Z2 <= file->Z2_max && Z2 <= workspace->Z2_max; Z2++) {
-            if (Z1 == JIBAL_ANY_Z || Z2 == JIBAL_ANY_Z || file == jibal_gsto_get_assigned_file(workspace, file->type, Z1, Z2)) {
-#ifdef DEBUG
-                fprintf(stderr, "File %s is assigned to Z1 = %i, Z2 = %i\n", file->name, Z1, Z2);
-#endif
-                /* This file is assigned to this Z1, Z2 combination, so we have to load the stopping in.
-                 * EXCEPTION: if either Z1 or Z2 is "ANY_Z" we ignore this whole skipping thing and just always load
-                 * in everything. */
-                if (Z1 == JIBAL_ANY_Z || Z2 == JIBAL_ANY_Z) {
-                    skip = 0;
-                } else {
-                    skip = file->xpoints * ((Z1 - previous_Z1) * (file->Z2_max - file->Z2_min + 1) +
-                                            (Z2 - previous_Z2 - 1)); /* Not sure if correct, but it works. */
-                }
-#ifdef DEBUG
-                fprintf(stderr, "Skipping %zu*(%i*%i+%i)=%zu lines.\n", file->xpoints, Z1-previous_Z1, file->Z1_max-file->Z2_min+1, Z2-previous_Z2-1, skip);
-                actually_skipped=0;
-#endif
+static void gsto_ascii_reader_init(gsto_ascii_reader *r, FILE *fp) {
+    r->fp = fp;
+    r->size = GSTO_INDEX_BUFFER_SIZE;
+    r->buf = malloc(r->size + 1);
+    r->len = 0;
+    r->pos = 0;
+    r->buf_offset = -1;
+    r->eof = FALSE;
+}
 
-                while (skip--) {
-                    file->lineno++;
-                    if(getline(&line, &line_size, file->fp) <= 0)
-                        break;
-                    if(*line == '#') {
-                        skip++; /* Undoing skip-- */
-#ifdef DEBUG
-                        fprintf(stderr, "Comment on line %i: %s", file->lineno, line+1);
-#endif
-                    } 
-                    actually_skipped++;
-                }
-#ifdef DEBUG
-                fprintf(stderr, "actually skipped %i lines, we should be now at line %i\n", actually_skipped, file->lineno);
-#endif
-                double *data = jibal_gsto_file_allocate_data(file, Z1, Z2);
-                if(!data)
-                    return 0;
-                for(i = 0; i < file->xpoints; i++) {
-                    if(getline(&line, &line_size, file->fp) <= 0) {
-                        fprintf(stderr, "ERROR: File %s ended prematurely when reading Z1=%i Z2=%i stopping point=%zu/%zu"
-                                        ".\n", file->filename, Z1, Z2, i+1, file->xpoints);
-                        file->valid = FALSE;
-                        break;
-                    }
-                    file->lineno++;
-                    if(*line == '#') { /* This line is a comment. Ignore. */
-                        i--;
-                    } else {
-#ifdef DEBUG
-                        fprintf(stderr, "Loading stopping [%i][%i][%zu] from line %i.\n", Z1, Z2, i, file->lineno);
-#endif
-                        line[strcspn(line, "\r\n")] = 0;  /* Strip newlines */
-                        char *end;
-                        data[i] = strtod(line, &end);
-                        if(end != line+strlen(line)) {
-                            fprintf(stderr, "Could not parse number from line %i from file %s: \"%s\". Got %g.\n", file->lineno, file->name, line, data[i]);
-                        }
-                    }
-                }
-                previous_Z1=Z1;
-                previous_Z2=Z2;
-                
-            }
-        }
+static void gsto_ascii_reader_free(gsto_ascii_reader *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
+
+static int gsto_ascii_reader_seek(gsto_ascii_reader *r, long offset) {
+    if(r->buf_offset >= 0 && offset >= r->buf_offset + (long)r->pos && offset <= r->buf_offset + (long)r->len) { /* Already in the buffer (and not consumed yet), e.g. when combinations are read in order */
+        r->pos = offset - r->buf_offset;
+        return 1;
     }
-    free(line);
+    if(fseek(r->fp, offset, SEEK_SET)) {
+        return 0;
+    }
+    r->buf_offset = offset;
+    r->len = 0;
+    r->pos = 0;
+    r->eof = FALSE;
     return 1;
 }
 
-void jibal_gsto_file_calculate_ncombs(gsto_file_t *file) {
-    if(file->Z1_min == JIBAL_ANY_Z) {
-        file->Z1_max = JIBAL_ANY_Z; /* For sanity, we can't have any Z1 but with a maximum. Then we should also have
- * a clearly defined minimum. */
-        if(file->Z2_min == JIBAL_ANY_Z) {
-            file->Z2_max = JIBAL_ANY_Z;
-            file->n_comb = 1; /* Any Z1, Z2, so maybe just one? */
-            return;
+static char *gsto_ascii_reader_getline(gsto_ascii_reader *r) { /* Returns next line without newline ("\n" or "\r\n"). The line is valid until the next call. NULL at the end of file. */
+    while(1) {
+        char *line = r->buf + r->pos;
+        char *newline = memchr(line, '\n', r->len - r->pos);
+        if(newline || (r->eof && r->pos < r->len)) {
+            char *end = newline ? newline : r->buf + r->len; /* Last line doesn't need to have a newline */
+            r->pos = end - r->buf + (newline ? 1 : 0);
+            if(end > line && end[-1] == '\r') {
+                end--;
+            }
+            *end = '\0';
+            return line;
         }
-        file->n_comb = (file->Z2_max - file->Z2_min + 1); /* Any Z1, some Z2 range */
-        return;
-    }
-    if(file->Z2_min == JIBAL_ANY_Z) {
-        file->Z2_max = JIBAL_ANY_Z;
-        file->n_comb = (file->Z1_max - file->Z1_min + 1); /* Any Z2, some Z1 range */
-        return;
+        if(r->eof) {
+            return NULL;
+        }
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos); /* Keep the partial line and read more */
+        r->buf_offset += r->pos;
+        r->len -= r->pos;
+        r->pos = 0;
+        if(r->len == r->size) { /* Very long line */
+            r->size *= 2;
+            r->buf = realloc(r->buf, r->size + 1);
+        }
+        size_t n = fread(r->buf + r->len, 1, r->size - r->len, r->fp);
+        if(n == 0) {
+            r->eof = TRUE;
+        }
+        r->len += n;
     }
-    file->n_comb = (file->Z1_max - file->Z1_min + 1) * (file->Z2_max - file->Z2_min + 1); /* Z1 and Z2 range */
 }
 
-int jibal_gsto_load(jibal_gsto *workspace, int headers_only, gsto_file_t *file) {
-    char *line = NULL;
-    size_t line_size = 0;
+static int gsto_file_read_ascii_data(const gsto_file_t *file, int Z1, int Z2, double *data, gsto_ascii_reader *r, int *lineno) { /* Reads xpoints
+ * values (one per line, comments are skipped) to data. Line number (for error messages) is kept in lineno, since the
+ * same file can be read by many threads. Returns 0 if the file ends prematurely. */
+    size_t i;
+    for(i = 0; i < file->xpoints; i++) {
+        char *line = gsto_ascii_reader_getline(r);
+        if(!line) {
+            fprintf(stderr, "ERROR: File %s ended prematurely when reading Z1=%i Z2=%i stopping point=%zu/%zu"
+                            ".\n", file->filename, Z1, Z2, i+1, file->xpoints);
+            return 0;
+        }
+        (*lineno)++;
+        if(*line == '#') { /* This line is a comment. Ignore. */
+            i--;
+        } else {
+#ifdef DEBUG
+            fprintf(stderr, "Loading stopping [%i][%i][%zu] from line %i.\n", Z1, Z2, i, *lineno);
+#endif
+            char *end;
+            data[i] = jibal_strtod(line, &end);
+            if(*end != '\0') {
+                fprintf(stderr, "Could not parse number from line %i from file %s: \"%s\". Got %g.\n", *lineno, file->name, line, data[i]);
+            }
+        }
+    }
+    return 1;
+}
+
+int jibal_gsto_file_index(gsto_file_t *file, size_t n) {
+    if(file->data_format == GSTO_DF_DOUBLE || file->data_format == GSTO_DF_CONTAINER) { /* Offsets can be calculated */
+        return 1;
+    }
+    if(n > file->n_comb) {
+        n = file->n_comb;
+    }
+    if(!file->offsets) {
+        file->offsets = malloc(sizeof(gsto_offset) * file->n_comb);
+        if(!file->offsets) {
+            return 0;
+        }
+        file->n_indexed = 0;
+    }
+    if(file->n_indexed >= n) {
+        return 1;
+    }
+    long pos = file->data_offset; /* Offset of buf[0] */
+    int lineno = file->data_lineno;
+    size_t i_comb = 0;
+    if(file->n_indexed) { /* Resume from the last known combination, its data lines are skipped below */
+        i_comb = file->n_indexed - 1;
+        pos = file->offsets[i_comb].offset;
+        lineno = file->offsets[i_comb].lineno;
+    }
+    if(fseek(file->fp, pos, SEEK_SET)) {
+        return 0;
+    }
+    char *buf = malloc(GSTO_INDEX_BUFFER_SIZE);
+    if(!buf) {
+        return 0;
+    }
+    int line_start = TRUE;
+    size_t n_lines = i_comb * file->xpoints; /* Lines of data (not comments) */
+    size_t n_read;
+    while(i_comb < n && (n_read = fread(buf, 1, GSTO_INDEX_BUFFER_SIZE, file->fp)) > 0) {
+        const char *p = buf, *end = buf + n_read;
+        while(p < end && i_comb < n) {
+            if(line_start) {
+                if(*p != '#') {
+                    if(n_lines % file->xpoints == 0) { /* First line of a new combination */
+                        if(i_comb >= file->n_indexed) { /* Known offsets are not rewritten, other threads may be reading them */
+                            file->offsets[i_comb].offset = pos + (p - buf);
+                            file->offsets[i_comb].lineno = lineno;
+                        }
+                        i_comb++;
+                    }
+                    n_lines++;
+                }
+                line_start = FALSE;
+            }
+            const char *newline = memchr(p, '\n', end - p);
+            if(!newline) { /* Line continues in the next block */
+                break;
+            }
+            p = newline + 1;
+            lineno++;
+            line_start = TRUE;
+        }
+        pos += n_read;
+    }
+    free(buf);
+    if(i_comb < n) { /* End of file, the rest is missing */
+        fprintf(stderr, "WARNING: File %s has data for only %zu combinations out of %zu.\n", file->filename, i_comb, file->n_comb);
+        for(; i_comb < file->n_comb; i_comb++) {
+            file->offsets[i_comb].offset = -1;
+            file->offsets[i_comb].lineno = 0;
+        }
+    }
+    file->n_indexed = i_comb;
+#ifdef DEBUG
+    fprintf(stderr, "Indexed %zu/%zu combinations of file %s.\n", file->n_indexed, file->n_comb, file->filename);
+#endif
+    return 1;
+}
+
+static char *gsto_file_index_filename(const gsto_file_t *file) {
+    size_t len = strlen(file->filename) + strlen(GSTO_INDEX_SUFFIX) + 1;
+    char *filename = malloc(len);
+    snprintf(filename, len, "%s%s", file->filename, GSTO_INDEX_SUFFIX);
+    return filename;
+}
+
+static int gsto_file_index_header(const gsto_file_t *file, gsto_index_header *header) { /* Header corresponding to the current state of the file */
+    struct stat st;
+    if(stat(file->filename, &st)) {
+        return 0;
+    }
+    memset(header, 0, sizeof(gsto_index_header));
+    memcpy(header->magic, GSTO_INDEX_MAGIC, sizeof(header->magic));
+    header->version = GSTO_INDEX_VERSION;
+    header->file_size = st.st_size;
+    header->file_mtime = st.st_mtime;
+    header->data_offset = file->data_offset;
+    header->n_comb = file->n_comb;
+    header->xpoints = file->xpoints;
+    return 1;
+}
+
+int jibal_gsto_file_index_read(gsto_file_t *file) {
+    gsto_index_header expected, header;
+    if(!gsto_file_index_header(file, &expected)) {
+        return 0;
+    }
+    char *filename = gsto_file_index_filename(file);
+    FILE *f = fopen(filename, "rb");
+    free(filename);
+    if(!f) {
+        return 0;
+    }
+    if(fread(&header, sizeof(gsto_index_header), 1, f) != 1 || memcmp(&header, &expected, sizeof(gsto_index_header)) != 0) {
+#ifdef DEBUG
+        fprintf(stderr, "Index of file %s is not valid (any more).\n", file->filename);
+#endif
+        fclose(f);
+        return 0;
+    }
+    int64_t *entries = malloc(sizeof(int64_t) * 2 * file->n_comb); /* Offset and line number */
+    if(fread(entries, sizeof(int64_t) * 2, file->n_comb, f) != file->n_comb) {
+        free(entries);
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+    gsto_offset *offsets = malloc(sizeof(gsto_offset) * file->n_comb);
+    int64_t previous = file->data_offset - 1;
+    for(size_t i = 0; i < file->n_comb; i++) {
+        offsets[i].offset = entries[2 * i];
+        offsets[i].lineno = entries[2 * i + 1];
+        if(offsets[i].offset < 0) { /* Missing data, rest must be missing too */
+            previous = header.file_size;
+            continue;
+        }
+        if(offsets[i].offset <= previous || (uint64_t)offsets[i].offset >= header.file_size || entries[2 * i + 1] <= 0 || entries[2 * i + 1] > INT_MAX) { /* Sanity check, offsets must be increasing */
+            free(entries);
+            free(offsets);
+            return 0;
+        }
+        previous = offsets[i].offset;
+    }
+    free(entries);
+    free(file->offsets);
+    file->offsets = offsets;
+    file->n_indexed = file->n_comb;
+    return 1;
+}
+
+int jibal_gsto_file_index_write(const gsto_file_t *file) {
+    gsto_index_header header;
+    if(!file->offsets || file->n_indexed < file->n_comb || !gsto_file_index_header(file, &header)) {
+        return 0;
+    }
+    char *filename = gsto_file_index_filename(file);
+    char *filename_tmp;
+    FILE *f = jibal_fopen_tmp(filename, &filename_tmp);
+    if(!f) { /* Data directory is probably not writable, that is fine. */
+        free(filename);
+        return 0;
+    }
+    int success = (fwrite(&header, sizeof(gsto_index_header), 1, f) == 1);
+    for(size_t i = 0; i < file->n_comb && success; i++) {
+        int64_t entry[2] = {file->offsets[i].offset, file->offsets[i].lineno};
+        success = (fwrite(entry, sizeof(int64_t), 2, f) == 2);
+    }
+    if(fclose(f)) {
+        success = FALSE;
+    }
+#ifdef WIN32
+    remove(filename); /* rename() doesn't replace on Windows */
+#endif
+    if(!success || rename(filename_tmp, filename)) {
+        remove(filename_tmp);
+        success = FALSE;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Writing index %s %s.\n", filename, success ? "succeeded" : "failed");
+#endif
+    free(filename);
+    free(filename_tmp);
+    return success;
+}
+
+static int gsto_file_index_ensure(const jibal_gsto *workspace, gsto_file_t *file, size_t n) { /* Makes sure offsets of the first n combinations are known. Caller must hold file->lock and have file->fp open. */
+    if(file->data_format == GSTO_DF_DOUBLE || file->data_format == GSTO_DF_CONTAINER || n == 0) {
+        return 1;
+    }
+    if(file->offsets && file->n_indexed >= n) {
+        return 1;
+    }
+    if(!file->offsets && jibal_gsto_file_index_read(file)) {
+        return 1;
+    }
+    if(!workspace->write_index) { /* Scan only as far as needed, later calls continue from there */
+        return jibal_gsto_file_index(file, n);
+    }
+    if(!jibal_gsto_file_index(file, file->n_comb)) { /* Index is written only once, so it has to be complete */
+        return 0;
+    }
+    jibal_gsto_file_index_write(file);
+    return 1;
+}
+
+static int gsto_load_wanted(const jibal_gsto *workspace, const gsto_file_t *file, int Z1, int Z2) { /* Combination should be loaded (see jibal_gsto_load_ascii_file()) */
+    if(Z1 > workspace->Z1_max || Z2 > workspace->Z2_max || gsto_file_get_raw_data(file, Z1, Z2)) {
+        return FALSE;
+    }
+    return Z1 == JIBAL_ANY_Z || Z2 == JIBAL_ANY_Z || file == jibal_gsto_get_assigned_file(workspace, file->type, Z1, Z2);
+}
+
+static size_t gsto_load_index_needed(const jibal_gsto *workspace, const gsto_file_t *file) { /* Number of combinations that have to be indexed to load everything wanted, i.e. highest wanted index + 1 */
+    size_t n = 0;
+    for(int Z1 = file->Z1_min; Z1 <= file->Z1_max; Z1++) {
+        for(int Z2 = file->Z2_min; Z2 <= file->Z2_max; Z2++) {
+            size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
+            if(i >= n && gsto_load_wanted(workspace, file, Z1, Z2)) {
+                n = i + 1;
+            }
+        }
+    }
+    return n;
+}
+
+int jibal_gsto_load_ascii_file(jibal_gsto *workspace, gsto_file_t *file) {
+    int Z1, Z2;
+    gsto_ascii_reader r;
+#ifdef DEBUG
+    fprintf(stderr, "Loading ascii data from file %s.\n", file->name);
+#endif
+    if(!gsto_file_index_ensure(workspace, file, gsto_load_index_needed(workspace, file))) { /* Combinations are found using the index, no need to read what is not needed */
+        return 0;
+    }
+    gsto_ascii_reader_init(&r, file->fp);
+    double *data = malloc(sizeof(double) * file->xpoints); /* Read buffer, published data is copied to the arena */
+    for (Z1 = file->Z1_min; Z1 <= file->Z1_max && Z1 <= workspace->Z1_max; Z1++) {
+        for (Z2 = file->Z2_min; Z2 <= file->Z2_max && Z2 <= workspace->Z2_max; Z2++) {
+            if (gsto_load_wanted(workspace, file, Z1, Z2)) {
+#ifdef DEBUG
+                fprintf(stderr, "File %s is assigned to Z1 = %i, Z2 = %i\n", file->name, Z1, Z2);
+#endif
+                /* This file is assigned to this Z1, Z2 combination and it hasn't been loaded yet, so we have to load
+                 * the stopping in. EXCEPTION: if either Z1 or Z2 is "ANY_Z" we always load in everything. */
+                const gsto_offset *o = &file->offsets[jibal_gsto_file_get_data_index(file, Z1, Z2)];
+                if(o->offset < 0 || !gsto_ascii_reader_seek(&r, o->offset)) {
+                    fprintf(stderr, "ERROR: No data for Z1=%i Z2=%i in file %s.\n", Z1, Z2, file->filename);
+                    file->valid = FALSE;
+                    free(data);
+                    gsto_ascii_reader_free(&r);
+                    return 0;
+                }
+                file->lineno = o->lineno;
+                if(!gsto_file_read_ascii_data(file, Z1, Z2, data, &r, &file->lineno)) {
+                    file->valid = FALSE;
+                    free(data);
+                    gsto_ascii_reader_free(&r);
+                    return 0;
+                }
+                if(!gsto_file_publish_data(file, Z1, Z2, data)) {
+                    free(data);
+                    gsto_ascii_reader_free(&r);
+                    return 0;
+                }
+            }
+        }
+    }
+    free(data);
+    gsto_ascii_reader_free(&r);
+    return 1;
+}
+
+void jibal_gsto_file_calculate_ncombs(gsto_file_t *file) {
+    if(file->Z1_min == JIBAL_ANY_Z) {
+        file->Z1_max = JIBAL_ANY_Z; /* For sanity, we can't have any Z1 but with a maximum. Then we should also have
+ * a clearly defined minimum. */
+        if(file->Z2_min == JIBAL_ANY_Z) {
+            file->Z2_max = JIBAL_ANY_Z;
+            file->n_comb = 1; /* Any Z1, Z2, so maybe just one? */
+            return;
+        }
+        file->n_comb = (file->Z2_max - file->Z2_min + 1); /* Any Z1, some Z2 range */
+        return;
+    }
+    if(file->Z2_min == JIBAL_ANY_Z) {
+        file->Z2_max = JIBAL_ANY_Z;
+        file->n_comb = (file->Z1_max - file->Z1_min + 1); /* Any Z2, some Z1 range */
+        return;
+    }
+    file->n_comb = (file->Z1_max - file->Z1_min + 1) * (file->Z2_max - file->Z2_min + 1); /* Z1 and Z2 range */
+}
+
+static int gsto_file_read_headers(gsto_file_t *file) { /* Opens file->fp and parses headers. The file is left open (after headers) if it is valid. */
+    char *line = NULL;
+    size_t line_size = 0;
     char *line_split;
     char *columns[3];
     char **col;
     int n_errors=0;
-    if (!file) {
-        return 0;
-    }
     file->fp = fopen(file->filename, "rb");
     if (!file->fp) {
         fprintf(stderr, "Could not open file \"%s\".\n", file->filename);
@@ -688,124 +1591,793 @@ int jibal_gsto_load(jibal_gsto *workspace, int headers_only, gsto_file_t *file)
     }
 
     jibal_gsto_file_calculate_ncombs(file);
-    if(headers_only || file->valid == FALSE) {
+    if(!file->valid) {
         fclose(file->fp);
-        return file->valid;
+        file->fp = NULL;
+        return FALSE;
     }
+    file->headers_end = ftell(file->fp);
+    file->headers_lineno = file->lineno;
+    return TRUE;
+}
 
-    jibal_gsto_file_free_data(file);
-    file->data = calloc(file->n_comb, sizeof(double *));
-
-    free(file->em);
-    file->em = jibal_gsto_em_table(file);
-
-    if(!file->em) {
-        fprintf(stderr, "WARNING: Could not make E/m table for file %s\n", file->name);
+static int gsto_file_open_data(gsto_file_t *file) { /* Opens file->fp at data_offset. Headers must have been read
+ * (gsto_file_read_headers()). On the first call the x table is made and file->data is allocated. Caller must hold
+ * file->lock. */
+    if(!file->valid) {
+        return 0;
+    }
+    file->fp = fopen(file->filename, "rb");
+    if(!file->fp || fseek(file->fp, file->data ? file->data_offset : file->headers_end, SEEK_SET)) {
+        fprintf(stderr, "Could not open file \"%s\".\n", file->filename);
+        if(file->fp) {
+            fclose(file->fp);
+            file->fp = NULL;
+        }
         file->valid = FALSE;
-        fclose(file->fp);
-        return file->valid;
+        return 0;
+    }
+    if(!file->data) { /* First time. Headers have been read already (header only load), but x table has to be made. */
+        file->lineno = file->headers_lineno;
+        free(file->em);
+        file->em = jibal_gsto_em_table(file);
+        if(!file->em) {
+            fprintf(stderr, "WARNING: Could not make E/m table for file %s\n", file->name);
+            file->valid = FALSE;
+            fclose(file->fp);
+            file->fp = NULL;
+            return file->valid;
+        }
+        file->data_offset = ftell(file->fp);
+        file->data_lineno = file->lineno;
+#ifndef GSTO_DONT_CONVERT_TO_SI
+        jibal_gsto_convert_file_to_SI(file);
+#endif
+        jibal_gsto_calculate_speedups(file);
+        if(file->single && file->data_format == GSTO_DF_CONTAINER) {
+            file->single = FALSE; /* Mapped data is used as it is */
+        }
+        if(file->single) {
+            free(file->single_scale);
+            file->single_scale = calloc(file->n_comb, sizeof(double));
+        }
+        gsto_file_resample_grid(file);
+        if(file->interleave && !file->il_data) {
+            file->il_data = calloc(file->n_comb, sizeof(gsto_point *));
+        }
+        if(file->evictable && !file->last_use) {
+            jibal_atomic_store_ptr(&file->last_use, calloc(file->n_comb, sizeof(size_t)));
+        }
+        jibal_atomic_store_ptr(&file->data, calloc(file->n_comb, sizeof(double *)));
+    } else {
+        file->lineno = file->data_lineno;
+    }
+    return 1;
+}
+
+static int gsto_file_load_data(jibal_gsto *workspace, gsto_file_t *file) { /* Loads combinations that are assigned to
+ * this file in workspace, but have not been loaded yet. Data that is already loaded is never modified or freed, so it
+ * can be used by other threads (and views) simultaneously. Caller must hold file->lock. */
+    if(!gsto_file_open_data(file)) {
+        return 0;
     }
     switch (file->data_format) {
         case GSTO_DF_DOUBLE:
             jibal_gsto_load_binary_file(workspace, file);
             break;
+        case GSTO_DF_CONTAINER:
+            jibal_gsto_load_container_file(workspace, file); /* Data is in SI units, nothing is converted */
+            break;
         case GSTO_DF_ASCII:
         default:
             jibal_gsto_load_ascii_file(workspace, file);
             break;
     }
     fclose(file->fp);
-#ifndef GSTO_DONT_CONVERT_TO_SI
-    jibal_gsto_convert_file_to_SI(file);
-#endif
-    jibal_gsto_calculate_speedups(file);
+    file->fp = NULL;
     return 1;
 }
 
-void jibal_gsto_calculate_speedups(gsto_file_t *file) {
-    file->xmin_speedup = 0.0;
-    file->xdiv = 0.0;
-    switch (file->xscale) {
-        case GSTO_XSCALE_LINEAR:
-            file->xmin_speedup = file->xmin;
-            file->xdiv = (file->xpoints - 1) / (file->xmax - file->xmin);
-            break;
-        case GSTO_XSCALE_LOG10:
-            file->xmin_speedup = log10(file->xmin);
-            file->xdiv = (file->xpoints - 1) / (log10(file->xmax) - log10(file->xmin));
-            break;
-        case GSTO_XSCALE_ARBITRARY:
-        default:
-            break;
+static int gsto_file_load_combination(const jibal_gsto *workspace, gsto_file_t *file, int Z1, int Z2) { /* Caller must hold file->lock */
+    if(file->data && gsto_file_get_raw_data(file, Z1, Z2)) { /* Loaded already, maybe by another thread */
+        return 1;
+    }
+    if(!gsto_file_open_data(file)) {
+        return 0;
+    }
+    size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
+    double *data = NULL;
+    switch (file->data_format) {
+        case GSTO_DF_CONTAINER:
+            jibal_gsto_load_container_file(NULL, file); /* Everything is mapped */
+            break;
+        case GSTO_DF_DOUBLE:
+            if(fseek(file->fp, file->data_offset + (long)(i * file->xpoints * sizeof(double)), SEEK_SET)) {
+                break;
+            }
+            data = calloc(file->xpoints, sizeof(double));
+            if(fread(data, sizeof(double), file->xpoints, file->fp) != file->xpoints) {
+                fprintf(stderr, "ERROR: Could not read Z1=%i Z2=%i from file %s.\n", Z1, Z2, file->filename);
+                free(data);
+                data = NULL;
+            }
+            break;
+        case GSTO_DF_ASCII:
+        default:
+            if(!gsto_file_index_ensure(workspace, file, i + 1)) {
+                break;
+            }
+            if(file->offsets[i].offset < 0) {
+                break;
+            }
+            gsto_ascii_reader r;
+            gsto_ascii_reader_init(&r, file->fp);
+            if(gsto_ascii_reader_seek(&r, file->offsets[i].offset)) {
+                file->lineno = file->offsets[i].lineno;
+                data = calloc(file->xpoints, sizeof(double));
+                if(!gsto_file_read_ascii_data(file, Z1, Z2, data, &r, &file->lineno)) {
+                    file->valid = FALSE;
+                    free(data);
+                    data = NULL;
+                }
+            }
+            gsto_ascii_reader_free(&r);
+            break;
+    }
+    if(data) {
+        gsto_file_publish_data(file, Z1, Z2, data); /* On failure nothing is published, see below */
+        free(data);
+    }
+    fclose(file->fp);
+    file->fp = NULL;
+    return gsto_file_get_raw_data(file, Z1, Z2) != NULL;
+}
+
+int jibal_gsto_load_combination(const jibal_gsto *workspace, gsto_file_t *file, int Z1, int Z2) {
+    if(!file || !jibal_gsto_file_has_combination(file, Z1, Z2)) {
+        return 0;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Loading Z1 = %i, Z2 = %i from file %s.\n", Z1, Z2, file->name);
+#endif
+    if(file->lock) {
+        jibal_mutex_lock(file->lock);
+    }
+    int ret = gsto_file_load_combination(workspace, file, Z1, Z2);
+    if(file->lock) {
+        jibal_mutex_unlock(file->lock);
+    }
+    return ret;
+}
+
+int jibal_gsto_load(jibal_gsto *workspace, int headers_only, gsto_file_t *file) {
+    if (!file) {
+        return 0;
+    }
+    if(headers_only) {
+        if(gsto_file_read_headers(file)) {
+            fclose(file->fp);
+            file->fp = NULL;
+        }
+        return file->valid;
+    }
+    if(file->lock) {
+        jibal_mutex_lock(file->lock);
+    }
+    double t_start = jibal_time();
+    int ret = gsto_file_load_data(workspace, file);
+    file->load_time += jibal_time() - t_start;
+    if(file->lock) {
+        jibal_mutex_unlock(file->lock);
+    }
+    return ret;
+}
+
+void jibal_gsto_calculate_speedups(gsto_file_t *file) {
+    file->xmin_speedup = 0.0;
+    file->xdiv = 0.0;
+    switch (file->xscale) {
+        case GSTO_XSCALE_LINEAR:
+            file->xmin_speedup = file->xmin;
+            file->xdiv = (file->xpoints - 1) / (file->xmax - file->xmin);
+            break;
+        case GSTO_XSCALE_LOG10:
+            file->xmin_speedup = log10(file->xmin);
+            file->xdiv = (file->xpoints - 1) / (log10(file->xmax) - log10(file->xmin));
+            break;
+        case GSTO_XSCALE_ARBITRARY:
+        default:
+            break;
+    }
+}
+
+void jibal_gsto_convert_file_to_SI(gsto_file_t *file) {
+    /* We convert energy per mass units to SI, this will possibly reduce conversions later.
+     *
+     * Note that we only recalculate xmin and xmax, since other variables are internally in SI.
+     *
+     * Stopping & straggling units are also converted, if necessary and/or possible. The data itself is converted
+     * one combination at a time as it is loaded (after this has been called).
+     *
+     * xunit, stounit and straggunit will reflect the units after conversion
+     *
+     * */
+    if(file->xunit == GSTO_X_UNIT_MEV_U) {
+        file->xmin *= C_MEV/C_U;
+        file->xmax *= C_MEV/C_U;
+        file->xunit = GSTO_X_UNIT_J_KG;
+    } else if(file->xunit == GSTO_X_UNIT_KEV_U) {
+        file->xmin *= C_KEV/C_U;
+        file->xmax *= C_KEV/C_U;
+        file->xunit = GSTO_X_UNIT_J_KG;
+    }
+
+    if(file->stounit == GSTO_STO_UNIT_EV15CM2) {
+        file->stounit = GSTO_STO_UNIT_JM2;
+    }
+
+    if(file->straggunit == GSTO_STRAGG_UNIT_BOHR && file->Z1_min != JIBAL_ANY_Z && file->Z2_min != JIBAL_ANY_Z) {
+        /* We can't convert if Z1 and Z2 and ambiguous. */
+        file->straggunit = GSTO_STRAGG_UNIT_J2M2;
+    }
+}
+
+typedef struct gsto_load_task { /* Work of jibal_gsto_load_all() when workspace->load_threads > 1 */
+    jibal_gsto *workspace;
+    gsto_file_t *file;
+    int Z1_min; /* Range of Z1 loaded by this task (second stage only) */
+    int Z1_max;
+    int success;
+    double t_start; /* When this task was started and finished, see jibal_time() */
+    double t_end;
+} gsto_load_task;
+
+typedef struct gsto_load_queue {
+    gsto_load_task *tasks;
+    size_t n_tasks;
+    size_t next; /* Index of next task to run, protected by lock */
+    jibal_mutex *lock;
+    void (*run)(gsto_load_task *task);
+} gsto_load_queue;
+
+static void gsto_load_worker(void *arg) { /* Runs tasks from the queue until there are none left */
+    gsto_load_queue *queue = arg;
+    while(1) {
+        jibal_mutex_lock(queue->lock);
+        size_t i = queue->next++;
+        jibal_mutex_unlock(queue->lock);
+        if(i >= queue->n_tasks) {
+            break;
+        }
+        gsto_load_task *task = &queue->tasks[i];
+        task->t_start = jibal_time();
+        queue->run(task);
+        task->t_end = jibal_time();
+    }
+}
+
+static void gsto_load_run_tasks(gsto_load_task *tasks, size_t n_tasks, int n_threads, void (*run)(gsto_load_task *)) { /* Runs
+ * tasks using n_threads threads (including the calling thread) and waits until all tasks have been run. */
+    gsto_load_queue queue = {.tasks = tasks, .n_tasks = n_tasks, .next = 0, .lock = jibal_mutex_new(), .run = run};
+    if(n_threads > (int)n_tasks) {
+        n_threads = (int)n_tasks;
+    }
+    int n_started = 0;
+    jibal_thread *threads = NULL;
+    if(n_threads > 1) {
+        threads = calloc(n_threads - 1, sizeof(jibal_thread));
+        for(int i = 0; i < n_threads - 1; i++) {
+            if(!jibal_thread_start(&threads[n_started], gsto_load_worker, &queue)) { /* Fine, we'll just do with fewer threads */
+                break;
+            }
+            n_started++;
+        }
+    }
+    gsto_load_worker(&queue);
+    for(int i = 0; i < n_started; i++) {
+        jibal_thread_join(&threads[i]);
+    }
+    free(threads);
+    jibal_mutex_free(queue.lock);
+}
+
+static void gsto_load_prepare(gsto_load_task *task) { /* First stage. Makes x table, data array and index (ASCII) of a file.
+ * Containers are loaded completely, since they are just mapped. */
+    gsto_file_t *file = task->file;
+    jibal_mutex_lock(file->lock);
+    if(file->data_format == GSTO_DF_CONTAINER) {
+        task->success = gsto_file_load_data(task->workspace, file);
+    } else {
+        task->success = gsto_file_open_data(file) && gsto_file_index_ensure(task->workspace, file, gsto_load_index_needed(task->workspace, file));
+        if(file->fp) {
+            fclose(file->fp);
+            file->fp = NULL;
+        }
+    }
+    jibal_mutex_unlock(file->lock);
+}
+
+static void gsto_load_range(gsto_load_task *task) { /* Second stage. Loads combinations Z1_min <= Z1 <= Z1_max. Data is
+ * read using our own file pointer, so tasks reading the same file don't block each other. The file is only locked to
+ * publish data. */
+    gsto_file_t *file = task->file;
+    task->success = FALSE;
+    FILE *fp = fopen(file->filename, "rb");
+    if(!fp) {
+        fprintf(stderr, "Could not open file \"%s\".\n", file->filename);
+        return;
+    }
+    gsto_ascii_reader r;
+    gsto_ascii_reader_init(&r, fp);
+    task->success = TRUE;
+    double *data = malloc(sizeof(double) * file->xpoints); /* Read buffer, published data is copied to the arena */
+    for(int Z1 = task->Z1_min; Z1 <= task->Z1_max && task->success; Z1++) {
+        for(int Z2 = file->Z2_min; Z2 <= file->Z2_max; Z2++) {
+            if(!gsto_load_wanted(task->workspace, file, Z1, Z2)) {
+                continue;
+            }
+            size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
+            if(file->data_format == GSTO_DF_DOUBLE) {
+                task->success = (fseek(fp, file->data_offset + (long)(i * file->xpoints * sizeof(double)), SEEK_SET) == 0 &&
+                                 fread(data, sizeof(double), file->xpoints, fp) == file->xpoints);
+            } else {
+                int lineno = file->offsets[i].lineno;
+                task->success = (file->offsets[i].offset >= 0 && gsto_ascii_reader_seek(&r, file->offsets[i].offset) &&
+                                 gsto_file_read_ascii_data(file, Z1, Z2, data, &r, &lineno));
+            }
+            jibal_mutex_lock(file->lock);
+            if(!task->success) {
+                fprintf(stderr, "ERROR: Could not read Z1=%i Z2=%i from file %s.\n", Z1, Z2, file->filename);
+                file->valid = FALSE;
+            } else if(!gsto_file_get_raw_data(file, Z1, Z2)) { /* Someone else could have been faster */
+                task->success = gsto_file_publish_data(file, Z1, Z2, data);
+            }
+            jibal_mutex_unlock(file->lock);
+            if(!task->success) {
+                break;
+            }
+        }
+    }
+    free(data);
+    gsto_ascii_reader_free(&r);
+    fclose(fp);
+}
+
+static int gsto_load_all_parallel(jibal_gsto *workspace) {
+    size_t i, n_files = 0;
+    gsto_load_task *files = calloc(workspace->n_files, sizeof(gsto_load_task));
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(!jibal_gsto_file_count_assignments(workspace, file)) {
+            continue;
+        }
+        files[n_files].workspace = workspace;
+        files[n_files].file = file;
+        n_files++;
+    }
+    gsto_load_run_tasks(files, n_files, workspace->load_threads, gsto_load_prepare);
+    size_t n_ranges = 0;
+    gsto_load_task *ranges = NULL;
+    for(i = 0; i < n_files; i++) { /* Split files to Z1 ranges of approximately GSTO_LOAD_TASK_POINTS points (that need to be loaded) */
+        gsto_file_t *file = files[i].file;
+        if(!files[i].success || file->data_format == GSTO_DF_CONTAINER) {
+            continue;
+        }
+        size_t points = 0;
+        int Z1_start = file->Z1_min;
+        for(int Z1 = file->Z1_min; Z1 <= file->Z1_max; Z1++) {
+            for(int Z2 = file->Z2_min; Z2 <= file->Z2_max; Z2++) {
+                if(gsto_load_wanted(workspace, file, Z1, Z2)) {
+                    points += file->xpoints;
+                }
+            }
+            if(points && (points >= GSTO_LOAD_TASK_POINTS || Z1 == file->Z1_max)) {
+                ranges = realloc(ranges, sizeof(gsto_load_task) * (n_ranges + 1));
+                ranges[n_ranges] = (gsto_load_task) {.workspace = workspace, .file = file, .Z1_min = Z1_start, .Z1_max = Z1, .success = FALSE};
+                n_ranges++;
+                points = 0;
+                Z1_start = Z1 + 1;
+            } else if(!points) {
+                Z1_start = Z1 + 1;
+            }
+        }
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Loading %zu files in %zu tasks using %i threads.\n", n_files, n_ranges, workspace->load_threads);
+#endif
+    gsto_load_run_tasks(ranges, n_ranges, workspace->load_threads, gsto_load_range);
+    for(i = 0; i < n_files; i++) { /* Loading time of a file is the time from start of the first stage to the end of its last range */
+        files[i].t_end -= files[i].t_start; /* Duration of the first stage */
+        files[i].t_start = 0.0;
+        double t_first = 0.0, t_last = 0.0;
+        for(size_t j = 0; j < n_ranges; j++) {
+            if(ranges[j].file != files[i].file) {
+                continue;
+            }
+            if(t_first == 0.0 || ranges[j].t_start < t_first) {
+                t_first = ranges[j].t_start;
+            }
+            if(ranges[j].t_end > t_last) {
+                t_last = ranges[j].t_end;
+            }
+            files[i].success = files[i].success && ranges[j].success;
+        }
+        files[i].t_end += t_last - t_first;
+    }
+    int n_success = 0;
+    for(i = 0; i < n_files; i++) {
+        jibal_mutex_lock(files[i].file->lock);
+        files[i].file->load_time += files[i].t_end;
+        jibal_mutex_unlock(files[i].file->lock);
+#ifdef DEBUG
+        fprintf(stderr, "File %s loaded in %.3lf ms.\n", files[i].file->name, files[i].t_end * 1000.0);
+#endif
+        n_success += files[i].success;
+    }
+    free(ranges);
+    free(files);
+    return n_success;
+}
+
+int jibal_gsto_load_all(jibal_gsto *workspace) { /* For every file, load combinations from file */
+    size_t i;
+    int n_success=0;
+    if(workspace->load_threads > 1) {
+        return gsto_load_all_parallel(workspace);
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        int assignments = jibal_gsto_file_count_assignments(workspace, file);
+        if(!assignments)
+            continue;
+        n_success += jibal_gsto_load(workspace, FALSE, file);
+    }
+    return n_success;
+}
+
+static void gsto_file_rebuild_lookup(gsto_file_t *file) { /* Resampled and interleaved data of loaded combinations is made
+ * again after file->resample or file->interleave has changed. Previous data stays in the arena until the data is freed. Caller must hold file->lock. */
+    size_t j;
+    gsto_file_free_lookup(file);
+    if(!file->data) { /* Nothing loaded, see gsto_file_open_data() */
+        return;
+    }
+    gsto_file_resample_grid(file);
+    if(file->interleave) {
+        file->il_data = calloc(file->n_comb, sizeof(gsto_point *));
+    }
+    for(j = 0; j < file->n_comb; j++) {
+        double *data = gsto_file_data_copy(file, j);
+        if(data) {
+            gsto_file_store_lookup(file, j, data);
+            free(data);
+        }
+    }
+}
+
+int jibal_gsto_resample(jibal_gsto *workspace, int points_per_decade) {
+    size_t i;
+    int n = 0;
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(file->lock) {
+            jibal_mutex_lock(file->lock);
+        }
+        if(points_per_decade < 0) {
+            points_per_decade = 0;
+        }
+        if(file->resample != points_per_decade) {
+            file->resample = points_per_decade; /* Data loaded later is resampled as it is loaded */
+            gsto_file_rebuild_lookup(file);
+        }
+        if(file->rs_data) {
+            n++;
+        }
+        if(file->lock) {
+            jibal_mutex_unlock(file->lock);
+        }
+    }
+    return n;
+}
+
+int jibal_gsto_resample_tolerance(jibal_gsto *workspace, double tolerance) {
+    size_t i;
+    int n = 0;
+    if(tolerance < 0.0) {
+        tolerance = 0.0;
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(file->lock) {
+            jibal_mutex_lock(file->lock);
+        }
+        if(file->rs_tolerance != tolerance) {
+            file->rs_tolerance = tolerance;
+            if(file->rs_data) { /* Combinations are resampled (or not) again */
+                gsto_file_rebuild_lookup(file);
+            }
+        }
+        n += file->rs_rejected;
+        if(file->lock) {
+            jibal_mutex_unlock(file->lock);
+        }
+    }
+    return n;
+}
+
+int jibal_gsto_interleave(jibal_gsto *workspace, int interleave) {
+    size_t i;
+    int n = 0;
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(file->lock) {
+            jibal_mutex_lock(file->lock);
+        }
+        if(file->interleave != (interleave != 0)) {
+            file->interleave = (interleave != 0);
+            gsto_file_rebuild_lookup(file);
+        }
+        n += file->interleave;
+        if(file->lock) {
+            jibal_mutex_unlock(file->lock);
+        }
+    }
+    return n;
+}
+
+int jibal_gsto_single_precision(jibal_gsto *workspace) {
+    size_t i;
+    int n = 0;
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(file->lock) {
+            jibal_mutex_lock(file->lock);
+        }
+        if(!file->data && file->data_format != GSTO_DF_CONTAINER) { /* Loaded data is never modified */
+            file->single = TRUE;
+        }
+        n += file->single;
+        if(file->lock) {
+            jibal_mutex_unlock(file->lock);
+        }
+    }
+    return n;
+}
+
+int jibal_gsto_cache_budget(jibal_gsto *workspace, size_t bytes) {
+    jibal_gsto *database = workspace->parent ? workspace->parent : workspace;
+    size_t i;
+    int n = 0;
+    database->cache_budget = bytes;
+    for(i = 0; i < database->n_files; i++) {
+        gsto_file_t *file = &database->files[i];
+        if(file->lock) {
+            jibal_mutex_lock(file->lock);
+        }
+        if(bytes && !file->data && file->data_format != GSTO_DF_CONTAINER) { /* Data in the arena can not be evicted */
+            file->evictable = TRUE;
+        }
+        n += file->evictable;
+        if(file->lock) {
+            jibal_mutex_unlock(file->lock);
+        }
+    }
+    return n;
+}
+
+static size_t gsto_file_combination_size(const gsto_file_t *file, size_t i) { /* Bytes of data, resampled data and interleaved data of combination i in memory */
+    const size_t unit = file->single ? sizeof(float) : sizeof(double);
+    double **data = jibal_atomic_load_ptr(&file->data);
+    size_t size = 0;
+    if(!data || !jibal_atomic_load_ptr(&data[i])) {
+        return 0;
+    }
+    size += file->xpoints * unit;
+    if(file->rs_data && jibal_atomic_load_ptr(&file->rs_data[i])) {
+        size += file->rs_points * unit;
+    }
+    if(file->il_data && jibal_atomic_load_ptr(&file->il_data[i])) { /* On the resampled grid if this combination is resampled */
+        size += (file->rs_data && jibal_atomic_load_ptr(&file->rs_data[i]) ? file->rs_points : file->xpoints) * sizeof(gsto_point);
+    }
+    return size;
+}
+
+static size_t gsto_cache_min_active(const jibal_gsto *database) { /* Caller must hold database->lock. Smallest epoch of
+ * pinned workspaces (database and its views), SIZE_MAX if none is pinned. */
+    size_t i;
+    size_t min = jibal_atomic_load_size_seq(&database->cache_active);
+    for(i = 0; i < database->n_views; i++) {
+        size_t active = jibal_atomic_load_size_seq(&database->views[i]->cache_active);
+        if(active < min) {
+            min = active;
+        }
+    }
+    return min;
+}
+
+static void gsto_cache_free_retired(jibal_gsto *database, size_t epoch) { /* Caller must hold database->lock. Frees data
+ * retired before epoch. Data retired in epoch e may be in use by workspaces pinned in epoch e or before. */
+    size_t i, n = 0;
+    for(i = 0; i < database->n_cache_retired; i++) {
+        gsto_cache_retired *r = &database->cache_retired[i];
+        if(r->epoch < epoch) {
+            free(r->data);
+        } else {
+            database->cache_retired[n++] = *r;
+        }
+    }
+    database->n_cache_retired = n;
+}
+
+static int gsto_cache_reserve_retired(jibal_gsto *database, size_t n) { /* Room for n more retired pointers */
+    if(database->n_cache_retired + n <= database->n_cache_retired_allocated) {
+        return TRUE;
     }
+    size_t n_alloc = database->n_cache_retired_allocated ? 2 * database->n_cache_retired_allocated : 64;
+    while(n_alloc < database->n_cache_retired + n) {
+        n_alloc *= 2;
+    }
+    gsto_cache_retired *retired = realloc(database->cache_retired, n_alloc * sizeof(gsto_cache_retired));
+    if(!retired) {
+        return FALSE;
+    }
+    database->cache_retired = retired;
+    database->n_cache_retired_allocated = n_alloc;
+    return TRUE;
 }
 
-void jibal_gsto_convert_file_to_SI(gsto_file_t *file) {
-    /* We convert energy per mass units to SI, this will possibly reduce conversions later.
-     *
-     * Note that we only recalculate xmin and xmax, since other variables are internally in SI.
-     *
-     * Stopping & straggling data is also converted, if necessary and/or possible
-     *
-     * xunit, stounit and straggunit will reflect the units after conversion
-     *
-     * */
-    if(file->xunit == GSTO_X_UNIT_MEV_U) {
-        file->xmin *= C_MEV/C_U;
-        file->xmax *= C_MEV/C_U;
-        file->xunit = GSTO_X_UNIT_J_KG;
-    } else if(file->xunit == GSTO_X_UNIT_KEV_U) {
-        file->xmin *= C_KEV/C_U;
-        file->xmax *= C_KEV/C_U;
-        file->xunit = GSTO_X_UNIT_J_KG;
+static void gsto_cache_release(jibal_gsto *database, void *p, int retire) {
+    if(!p) {
+        return;
     }
+    if(retire) {
+        gsto_cache_retired *r = &database->cache_retired[database->n_cache_retired++];
+        r->data = p;
+        r->epoch = jibal_atomic_load_size(&database->cache_epoch);
+    } else {
+        free(p);
+    }
+}
 
-    if(file->stounit == GSTO_STO_UNIT_EV15CM2) {
-        size_t i_comb;
-        for (i_comb = 0; i_comb < file->n_comb; i_comb++) {
-            double *data = file->data[i_comb];
-            if (data) {
-                size_t i;
-                for (i = 0; i < file->xpoints; i++) {
-                    data[i] *= C_EV_TFU;
-                }
+static int gsto_file_evict(jibal_gsto *database, gsto_file_t *file, size_t i, int retire) { /* Caller must hold database->lock and
+ * file->lock. If retire is TRUE, data is freed later (see gsto_cache_free_retired()) instead of now, since other threads may still use it. */
+    if(retire && !gsto_cache_reserve_retired(database, 3)) {
+        return FALSE;
+    }
+    if(file->rs_data) {
+        gsto_cache_release(database, file->rs_data[i], retire);
+        jibal_atomic_store_ptr(&file->rs_data[i], NULL);
+    }
+    if(file->il_data) {
+        gsto_cache_release(database, file->il_data[i], retire);
+        jibal_atomic_store_ptr(&file->il_data[i], NULL);
+    }
+    gsto_cache_release(database, file->data[i], retire);
+    jibal_atomic_store_ptr(&file->data[i], NULL);
+    return TRUE;
+}
+
+typedef struct gsto_cache_entry { /* Combination in memory, see gsto_cache_trim() */
+    gsto_file_t *file;
+    size_t i;
+    size_t last_use;
+    size_t size;
+} gsto_cache_entry;
+
+static int gsto_cache_entry_compare(const void *a, const void *b) { /* Least recently used first */
+    const gsto_cache_entry *x = a, *y = b;
+    return (x->last_use > y->last_use) - (x->last_use < y->last_use);
+}
+
+static size_t gsto_cache_trim(jibal_gsto *database, size_t target, int automatic) { /* Caller must hold database->lock. Evicts
+ * least recently used combinations until at most target bytes are in memory. Automatic trimming doesn't evict
+ * combinations looked up since the previous trim and retires data instead of freeing it. Returns bytes evicted. */
+    size_t i, j, n = 0, n_max = 0, resident = 0, freed = 0;
+    size_t epoch = jibal_atomic_load_size(&database->cache_epoch);
+    gsto_cache_free_retired(database, automatic ? gsto_cache_min_active(database) : SIZE_MAX);
+    for(i = 0; i < database->n_files; i++) {
+        const gsto_file_t *file = &database->files[i];
+        double **data = jibal_atomic_load_ptr(&file->data);
+        for(j = 0; file->evictable && data && j < file->n_comb; j++) {
+            n_max += (jibal_atomic_load_ptr(&data[j]) != NULL);
+        }
+    }
+    gsto_cache_entry *entries = malloc(sizeof(gsto_cache_entry) * (n_max ? n_max : 1));
+    if(!entries) {
+        return 0;
+    }
+    for(i = 0; i < database->n_files; i++) {
+        gsto_file_t *file = &database->files[i];
+        size_t *last_use = jibal_atomic_load_ptr(&file->last_use);
+        for(j = 0; file->evictable && jibal_atomic_load_ptr(&file->data) && j < file->n_comb; j++) {
+            size_t size = gsto_file_combination_size(file, j);
+            if(!size) {
+                continue;
+            }
+            resident += size;
+            size_t used = last_use ? jibal_atomic_load_size(&last_use[j]) : 0;
+            if((automatic && used == epoch) || n == n_max) { /* In use, or loaded by another thread after counting */
+                continue;
             }
+            gsto_cache_entry *e = &entries[n++];
+            e->file = file;
+            e->i = j;
+            e->last_use = used;
+            e->size = size;
         }
-        file->stounit = GSTO_STO_UNIT_JM2;
     }
-
-    if(file->straggunit == GSTO_STRAGG_UNIT_BOHR && file->Z1_min != JIBAL_ANY_Z && file->Z2_min != JIBAL_ANY_Z) {
-        /* We can't convert if Z1 and Z2 and ambiguous. Also the following algorithm doesn't check for overlaps and would
-         * convert some data twice. */
-        int Z1, Z2;
-        for (Z1=file->Z1_min; Z1 <= file->Z1_max; Z1++) {
-            for (Z2 = file->Z2_min; Z2 <= file->Z2_max; Z2++) {
-                int i_comb=jibal_gsto_file_get_data_index(file, Z1, Z2);
-                double *data = file->data[i_comb];
-                if (data) {
-                    size_t i;
-                    for (i = 0; i < file->xpoints; i++) {
-                        data[i] *= jibal_stragg_bohr(Z1, Z2);
-                    }
-                }
+    if(resident > target) {
+        qsort(entries, n, sizeof(gsto_cache_entry), gsto_cache_entry_compare);
+        for(i = 0; i < n && resident > target; i++) {
+            gsto_cache_entry *e = &entries[i];
+            jibal_mutex_lock(e->file->lock);
+            int evicted = gsto_file_evict(database, e->file, e->i, automatic);
+            jibal_mutex_unlock(e->file->lock);
+            if(!evicted) {
+                break;
             }
+            resident -= e->size;
+            freed += e->size;
+            database->cache_evictions++;
         }
-        file->straggunit = GSTO_STRAGG_UNIT_J2M2;
     }
+    free(entries);
+    jibal_atomic_store_size(&database->cache_loaded, resident);
+    jibal_atomic_store_size_seq(&database->cache_epoch, epoch + 1);
+    return freed;
+}
 
+void jibal_gsto_cache_pin(const jibal_gsto *workspace) {
+    jibal_gsto *w = (jibal_gsto *) workspace; /* A workspace is used by one thread at a time */
+    const jibal_gsto *database = workspace->parent ? workspace->parent : workspace;
+    if(w->cache_pins++ == 0 && database->cache_budget) {
+        jibal_atomic_store_size_seq(&w->cache_active, jibal_atomic_load_size_seq(&database->cache_epoch));
+    }
 }
 
-int jibal_gsto_load_all(jibal_gsto *workspace) { /* For every file, load combinations from file */
-    size_t i;
-    int n_success=0;
-    for(i = 0; i < workspace->n_files; i++) {
-        gsto_file_t *file = &workspace->files[i];
-        int assignments = jibal_gsto_file_count_assignments(workspace, file);
-        if(!assignments)
-            continue;
-        n_success += jibal_gsto_load(workspace, FALSE, file);
+void jibal_gsto_cache_unpin(const jibal_gsto *workspace) {
+    jibal_gsto *w = (jibal_gsto *) workspace;
+    assert(w->cache_pins > 0);
+    if(--w->cache_pins == 0 && w->cache_active != SIZE_MAX) {
+        jibal_atomic_store_size_seq(&w->cache_active, SIZE_MAX);
     }
-    return n_success;
+}
+
+static void gsto_cache_auto_trim(jibal_gsto *database) {
+    jibal_mutex_lock(database->lock);
+    if(jibal_atomic_load_size(&database->cache_loaded) > database->cache_budget) { /* Another thread may have trimmed already */
+        gsto_cache_trim(database, database->cache_budget - database->cache_budget / GSTO_CACHE_TRIM_SLACK, TRUE);
+    }
+    jibal_mutex_unlock(database->lock);
+}
+
+size_t jibal_gsto_cache_trim(jibal_gsto *workspace) {
+    jibal_gsto *database = workspace->parent ? workspace->parent : workspace;
+    if(!database->cache_budget) {
+        return 0;
+    }
+    jibal_mutex_lock(database->lock);
+    size_t freed = gsto_cache_trim(database, database->cache_budget, FALSE);
+    jibal_mutex_unlock(database->lock);
+    return freed;
+}
+
+jibal_gsto_cache_stats jibal_gsto_cache_get_stats(const jibal_gsto *workspace) {
+    const jibal_gsto *database = workspace->parent ? workspace->parent : workspace;
+    jibal_gsto_cache_stats stats;
+    size_t i, j;
+    stats.budget = database->cache_budget;
+    stats.resident = 0;
+    for(i = 0; i < database->n_files; i++) {
+        const gsto_file_t *file = &database->files[i];
+        for(j = 0; file->evictable && j < file->n_comb; j++) {
+            stats.resident += gsto_file_combination_size(file, j);
+        }
+    }
+    stats.hits = workspace->cache_hits;
+    stats.misses = workspace->cache_misses;
+    stats.evictions = database->cache_evictions;
+    return stats;
 }
 
 int jibal_gsto_file_count_assignments(const jibal_gsto *workspace, gsto_file_t *file) {
@@ -846,6 +2418,9 @@ int jibal_gsto_print_files(const jibal_gsto *workspace, int used_only) {
         if(assignments) {
             fprintf(stderr, "\t%i assignments,\n", assignments);
         }
+        if(file->load_time > 0.0) {
+            fprintf(stderr, "\tloading took %.3lf ms,\n", file->load_time * 1000.0);
+        }
         if(file->Z1_min == file->Z1_max) {
             fprintf(stderr, "\tZ1 = %i (%s)\n", file->Z1_min, jibal_element_name(workspace->elements, file->Z1_min));
         } else {
@@ -869,6 +2444,28 @@ int jibal_gsto_print_files(const jibal_gsto *workspace, int used_only) {
         }
         fprintf(stderr, "\tx-min=%e\n", file->xmin);
         fprintf(stderr, "\tx-max=%e\n", file->xmax);
+        if(file->single) {
+            fprintf(stderr, "\tsingle precision, largest relative error %.3e\n", file->single_error);
+        }
+        if(file->rs_data) {
+            fprintf(stderr, "\tresampled to %i points per decade (%zu points), largest relative error %.3e\n", file->resample, file->rs_points, file->rs_error);
+            if(file->rs_rejected) {
+                fprintf(stderr, "\t%zu combinations not resampled, error would exceed %.3e\n", file->rs_rejected, file->rs_tolerance);
+            }
+        }
+        if(file->il_data) {
+            fprintf(stderr, "\tinterleaved\n");
+        }
+        if(file->arena) {
+            fprintf(stderr, "\tdata in memory=%zu bytes\n", gsto_arena_size(file));
+        }
+        if(file->evictable) {
+            size_t j, size = 0;
+            for(j = 0; j < file->n_comb; j++) {
+                size += gsto_file_combination_size(file, j);
+            }
+            fprintf(stderr, "\tevictable, data in memory=%zu bytes\n", size);
+        }
         if(file->stounit != GSTO_STO_UNIT_NONE) {
             if (file->stounit == file->stounit_original) {
                 fprintf(stderr, "\tstopping unit=%s\n", gsto_get_header_string(gsto_sto_units, file->stounit_original));
@@ -950,6 +2547,11 @@ int jibal_gsto_auto_assign(jibal_gsto *workspace, int Z1, int Z2) {
 
 jibal_gsto *jibal_gsto_init(const jibal_element *elements, int Z_max, const char *files_file_name,
                             const char *assignments_file_name) {
+    return jibal_gsto_init_manifest(elements, Z_max, files_file_name, assignments_file_name, NULL);
+}
+
+jibal_gsto *jibal_gsto_init_manifest(const jibal_element *elements, int Z_max, const char *files_file_name,
+                            const char *assignments_file_name, const char *manifest_file_name) {
     jibal_gsto *workspace;
     workspace = gsto_allocate(Z_max, Z_max);
     workspace->elements = elements;
@@ -958,12 +2560,31 @@ jibal_gsto *jibal_gsto_init(const jibal_element *elements, int Z_max, const char
     }
     workspace->stop_step = JIBAL_STEP_SIZE; /* TODO: set this from some configuration. Used only for layer energy
  * loss calculations */
+    workspace->stop_tolerance = 0.0;
     workspace->extrapolate = FALSE;
-    jibal_gsto_read_settings_file(workspace, files_file_name);
+    workspace->lazy = FALSE;
+    workspace->write_index = FALSE;
+    workspace->load_threads = 1;
+    if(!jibal_gsto_manifest_read(workspace, manifest_file_name, files_file_name)) {
+        jibal_gsto_read_settings_file(workspace, files_file_name);
+        jibal_gsto_manifest_write(workspace, manifest_file_name, files_file_name);
+    }
     workspace->overrides = jibal_gsto_read_assignments_file(workspace, assignments_file_name);
     return workspace;
 }
 
+static void gsto_add_rejected(jibal_gsto *workspace, const char *filename) { /* File listed in the settings file could not be added */
+    char **rejected = realloc(workspace->rejected, sizeof(char *) * (workspace->n_rejected + 1));
+    if(!rejected) {
+        return;
+    }
+    workspace->rejected = rejected;
+    workspace->rejected[workspace->n_rejected] = strdup(filename);
+    if(workspace->rejected[workspace->n_rejected]) {
+        workspace->n_rejected++;
+    }
+}
+
 int jibal_gsto_read_settings_file(jibal_gsto *workspace, const char *filename) {
     if(!filename) {
         fprintf(stderr, "WARNING: GSTO files configuration not found. Maybe you don't have %s anywhere?\n", JIBAL_FILES_FILE);
@@ -1013,81 +2634,551 @@ int jibal_gsto_read_settings_file(jibal_gsto *workspace, const char *filename) {
             } else {
                 fprintf(stderr, "WARNING: adding file %s failed.\n", file);
                 n_errors++;
+                gsto_add_rejected(workspace, file);
+            }
+        } else {
+            fprintf(stderr, "WARNING: adding stopping file failed, since line %i in %s is malformed.\n", lineno, file);
+            n_errors++;
+        }
+        if(file != columns[1] && file) { /* Free filename if it was allocated */
+            free(file);
+        }
+    }
+#ifdef DEBUG
+    fprintf(stderr, "GSTO: Read %i lines from settings file, added %i files, attempt to add %i files failed.\n", lineno, n_files, n_errors);
+#endif
+    fclose(f);
+    free(line);
+    return n_files;
+}
+
+gsto_assignment *jibal_gsto_read_assignments_file(jibal_gsto *workspace, const char *filename) {
+    if(!filename) {
+        fprintf(stderr, "WARNING: No assignments filename given. Maybe you don't have %s anywhere? Create an empty file to suppress this warning.\n", JIBAL_ASSIGNMENTS_FILE);
+        return NULL;
+    }
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "WARNING: Can not open file %s. Create an empty file to suppress this warning.\n", filename);
+        return NULL;
+    }
+    char *line = NULL;
+    char *line_split;
+    char *columns[3];
+    char **col;
+    int lineno = 0, n_possible = 0, n_actual = 0;
+    size_t line_size=0;
+    while(getline(&line, &line_size, f) > 0) { if (line[0] != '#') { n_possible++; }}
+    if (n_possible == 0) {
+        free(line);
+        return NULL;
+    }
+    rewind(f);
+    gsto_assignment *a = calloc(n_possible + 1, sizeof(gsto_assignment)); /* Terminated by one with file == NULL */
+    while(getline(&line, &line_size, f) > 0) {
+        lineno++;
+        if (line[0] == '#') /* Strip comments */
+            continue;
+        line_split = line; /* strsep will screw up line_split, reset for every new line */
+        /* We read in two columns (hard coded), first is the name and the second is the filename. */
+        for (col = columns; col < &columns[3]; col++) { *col = NULL; }
+        for (col = columns; (*col = strsep(&line_split, ",\t\r\n")) != NULL;) {
+            if (**col != '\0')
+                if (++col >= &columns[3])
+                    break;
+        }
+        const jibal_element *incident = jibal_element_find(workspace->elements, columns[0]);
+        if (!incident) {
+            fprintf(stderr, "WARNING: No such element: %s in file %s", columns[0], filename);
+            continue;
+        }
+        const jibal_element *target = jibal_element_find(workspace->elements, columns[1]);
+        if (!target) {
+            fprintf(stderr, "WARNING: No such element: %s in file %s", columns[1], filename);
+            continue;
+        }
+        gsto_file_t *file = jibal_gsto_get_file(workspace, columns[2]);
+        if (!file) {
+            fprintf(stderr, "WARNING: No such GSTO file: %s in file %s", columns[2], filename);
+            continue;
+        }
+        gsto_assignment *ass = &a[n_actual];
+        ass->Z1 = incident->Z;
+        ass->Z2 = target->Z;
+        ass->file = file;
+        n_actual++;
+    }
+    free(line);
+    return a; /* Remember to free this */
+}
+
+static size_t gsto_image_align8(size_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+int jibal_gsto_file_record_write(FILE *f, const gsto_file_t *file, int with_em) {
+    struct stat st;
+    if(!file->valid || !file->name || !file->filename || stat(file->filename, &st)) {
+        return 0;
+    }
+    gsto_file_record r;
+    memset(&r, 0, sizeof(gsto_file_record));
+    r.has_em = with_em && file->data && file->em;
+    r.file_size = st.st_size;
+    r.file_mtime = st.st_mtime;
+    r.Z1_min = file->Z1_min;
+    r.Z1_max = file->Z1_max;
+    r.Z2_min = file->Z2_min;
+    r.Z2_max = file->Z2_max;
+    r.type = file->type;
+    r.data_format = file->data_format;
+    r.xscale = file->xscale;
+    r.xunit_original = file->xunit_original;
+    r.stounit_original = file->stounit_original;
+    r.straggunit_original = file->straggunit_original;
+    r.xpoints = file->xpoints;
+    r.xmin_original = file->xmin_original;
+    r.xmax_original = file->xmax_original;
+    r.headers_end = file->headers_end;
+    r.headers_lineno = file->headers_lineno;
+    if(r.has_em) { /* Units have been converted too */
+        r.xunit = file->xunit;
+        r.stounit = file->stounit;
+        r.straggunit = file->straggunit;
+        r.xmin = file->xmin;
+        r.xmax = file->xmax;
+        r.data_offset = file->data_offset;
+        r.data_lineno = file->data_lineno;
+    } else {
+        r.xunit = file->xunit_original;
+        r.stounit = file->stounit_original;
+        r.straggunit = file->straggunit_original;
+        r.xmin = file->xmin_original;
+        r.xmax = file->xmax_original;
+        r.data_offset = 0;
+        r.data_lineno = 0;
+    }
+    r.name_length = strlen(file->name);
+    r.filename_length = strlen(file->filename);
+    r.source_length = file->source ? strlen(file->source) : 0;
+    size_t size = sizeof(gsto_file_record) + (r.has_em ? sizeof(double) * file->xpoints : 0) + r.name_length + r.filename_length + r.source_length;
+    r.record_size = gsto_image_align8(size);
+    if(fwrite(&r, sizeof(gsto_file_record), 1, f) != 1) {
+        return 0;
+    }
+    if(r.has_em && fwrite(file->em, sizeof(double), file->xpoints, f) != file->xpoints) {
+        return 0;
+    }
+    if(fwrite(file->name, 1, r.name_length, f) != r.name_length || fwrite(file->filename, 1, r.filename_length, f) != r.filename_length) {
+        return 0;
+    }
+    if(r.source_length && fwrite(file->source, 1, r.source_length, f) != r.source_length) {
+        return 0;
+    }
+    gsto_fprint_padding(f, r.record_size - size);
+    return !ferror(f);
+}
+
+static char *gsto_record_string(const char *p, size_t len) {
+    char *s = malloc(len + 1);
+    memcpy(s, p, len);
+    s[len] = '\0';
+    return s;
+}
+
+size_t jibal_gsto_file_record_read(gsto_file_t *file, const char *record, size_t size) {
+    gsto_file_record r;
+    struct stat st;
+    if(size < sizeof(gsto_file_record)) {
+        return 0;
+    }
+    memcpy(&r, record, sizeof(gsto_file_record));
+    if(r.has_em && r.xpoints > size / sizeof(double)) {
+        return 0;
+    }
+    size_t em_size = r.has_em ? sizeof(double) * r.xpoints : 0;
+    if(r.record_size > size || r.record_size % 8 || r.name_length == 0 || r.filename_length == 0 ||
+       sizeof(gsto_file_record) + em_size + r.name_length + r.filename_length + r.source_length > r.record_size) {
+        return 0;
+    }
+    const char *p = record + sizeof(gsto_file_record);
+    memset(file, 0, sizeof(gsto_file_t));
+    file->filename = gsto_record_string(p + em_size + r.name_length, r.filename_length);
+    if(stat(file->filename, &st) || (uint64_t)st.st_size != r.file_size || (int64_t)st.st_mtime != r.file_mtime) {
+#ifdef DEBUG
+        fprintf(stderr, "File %s has changed, record is not valid.\n", file->filename);
+#endif
+        free(file->filename);
+        file->filename = NULL;
+        return 0;
+    }
+    file->valid = TRUE;
+    file->name = gsto_record_string(p + em_size, r.name_length);
+    file->source = r.source_length ? gsto_record_string(p + em_size + r.name_length + r.filename_length, r.source_length) : NULL;
+    file->Z1_min = r.Z1_min;
+    file->Z1_max = r.Z1_max;
+    file->Z2_min = r.Z2_min;
+    file->Z2_max = r.Z2_max;
+    file->type = r.type;
+    file->data_format = r.data_format;
+    file->xscale = r.xscale;
+    file->xunit = r.xunit;
+    file->xunit_original = r.xunit_original;
+    file->stounit = r.stounit;
+    file->stounit_original = r.stounit_original;
+    file->straggunit = r.straggunit;
+    file->straggunit_original = r.straggunit_original;
+    file->xpoints = r.xpoints;
+    file->xmin = r.xmin;
+    file->xmin_original = r.xmin_original;
+    file->xmax = r.xmax;
+    file->xmax_original = r.xmax_original;
+    file->headers_end = r.headers_end;
+    file->headers_lineno = r.headers_lineno;
+    file->lineno = r.headers_lineno;
+    jibal_gsto_file_calculate_ncombs(file);
+    if(r.has_em) { /* State after gsto_file_open_data() has been called for the first time */
+        file->em = malloc(em_size);
+        memcpy(file->em, p, em_size);
+        file->data_offset = r.data_offset;
+        file->data_lineno = r.data_lineno;
+        jibal_gsto_calculate_speedups(file);
+        file->data = calloc(file->n_comb, sizeof(double *));
+    }
+    file->lock = jibal_mutex_new();
+    return r.record_size;
+}
+
+static int64_t gsto_image_file_index(const jibal_gsto *workspace, const gsto_file_t *file) {
+    return file ? file - workspace->files : -1;
+}
+
+static int gsto_image_data_wanted(const gsto_file_t *file, int with_data) { /* Data of mapped containers is not copied to the image */
+    return with_data && file->data && file->data_format != GSTO_DF_CONTAINER;
+}
+
+int jibal_gsto_image_write(FILE *f, const jibal_gsto *workspace, int with_data) {
+    size_t i, j;
+    gsto_image_header header;
+    memset(&header, 0, sizeof(gsto_image_header));
+    header.Z1_max = workspace->Z1_max;
+    header.Z2_max = workspace->Z2_max;
+    header.n_files = workspace->n_files;
+    if(workspace->overrides) {
+        while(workspace->overrides[header.n_overrides].file) {
+            header.n_overrides++;
+        }
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        const gsto_file_t *file = &workspace->files[i];
+        for(j = 0; gsto_image_data_wanted(file, with_data) && j < file->n_comb; j++) {
+            header.n_data += (file->data[j] != NULL);
+        }
+    }
+    if(fwrite(&header, sizeof(gsto_image_header), 1, f) != 1) {
+        return 0;
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        if(!jibal_gsto_file_record_write(f, &workspace->files[i], with_data)) {
+            fprintf(stderr, "Could not write record of file %s to an image.\n", workspace->files[i].name);
+            return 0;
+        }
+    }
+    for(i = 0; i < header.n_overrides; i++) {
+        const gsto_assignment *a = &workspace->overrides[i];
+        gsto_image_override o = {.Z1 = a->Z1, .Z2 = a->Z2, .file = gsto_image_file_index(workspace, a->file)};
+        if(fwrite(&o, sizeof(gsto_image_override), 1, f) != 1) {
+            return 0;
+        }
+    }
+    for(i = 0; i < 2 * workspace->n_comb; i++) {
+        const gsto_file_t *file = i < workspace->n_comb ? workspace->stop_assignments[i] : workspace->stragg_assignments[i - workspace->n_comb];
+        int32_t index = gsto_image_file_index(workspace, file);
+        if(fwrite(&index, sizeof(int32_t), 1, f) != 1) {
+            return 0;
+        }
+    }
+    if(!gsto_fprint_padding(f, gsto_image_align8(2 * workspace->n_comb * sizeof(int32_t)) - 2 * workspace->n_comb * sizeof(int32_t))) {
+        return 0;
+    }
+    uint64_t offset = 0;
+    for(i = 0; i < workspace->n_files; i++) {
+        const gsto_file_t *file = &workspace->files[i];
+        for(j = 0; gsto_image_data_wanted(file, with_data) && j < file->n_comb; j++) {
+            if(!file->data[j]) {
+                continue;
+            }
+            gsto_image_data d = {.file = i, .i_comb = j, .offset = offset};
+            if(fwrite(&d, sizeof(gsto_image_data), 1, f) != 1) {
+                return 0;
+            }
+            offset += (file->xpoints * sizeof(double) + GSTO_IMAGE_ALIGN - 1) / GSTO_IMAGE_ALIGN * GSTO_IMAGE_ALIGN;
+        }
+    }
+    long pos = ftell(f);
+    if(pos < 0 || !gsto_fprint_padding(f, (GSTO_IMAGE_ALIGN - pos % GSTO_IMAGE_ALIGN) % GSTO_IMAGE_ALIGN)) {
+        return 0;
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        const gsto_file_t *file = &workspace->files[i];
+        for(j = 0; gsto_image_data_wanted(file, with_data) && j < file->n_comb; j++) {
+            if(!file->data[j]) {
+                continue;
+            }
+            double *data = gsto_file_data_copy(file, j); /* Single precision data is written in double precision */
+            if(!data) { /* Out of memory, entries have already been written */
+                return 0;
+            }
+            size_t size = file->xpoints * sizeof(double);
+            int success = (fwrite(data, sizeof(double), file->xpoints, f) == file->xpoints &&
+                           gsto_fprint_padding(f, (GSTO_IMAGE_ALIGN - size % GSTO_IMAGE_ALIGN) % GSTO_IMAGE_ALIGN));
+            free(data);
+            if(!success) {
+                return 0;
             }
+        }
+    }
+    return !ferror(f);
+}
+
+jibal_gsto *jibal_gsto_image_read(const jibal_element *elements, const char *image, size_t image_size, size_t offset) {
+    gsto_image_header header;
+    size_t i;
+    if(offset % 8 || offset + sizeof(gsto_image_header) > image_size) {
+        return NULL;
+    }
+    memcpy(&header, image + offset, sizeof(gsto_image_header));
+    if(header.Z1_max <= 0 || header.Z2_max <= 0 || (uint64_t)header.Z1_max * header.Z2_max > image_size || header.n_files > image_size || header.n_overrides > image_size || header.n_data > image_size) {
+        return NULL;
+    }
+    offset += sizeof(gsto_image_header);
+    jibal_gsto *workspace = gsto_allocate(header.Z1_max, header.Z2_max);
+    workspace->elements = elements;
+    workspace->stop_step = JIBAL_STEP_SIZE;
+    workspace->stop_tolerance = 0.0;
+    workspace->extrapolate = FALSE;
+    if(header.n_files) {
+        workspace->files = calloc(header.n_files, sizeof(gsto_file_t));
+    }
+    for(i = 0; i < header.n_files; i++) {
+        size_t size = jibal_gsto_file_record_read(&workspace->files[i], image + offset, image_size - offset);
+        if(!size) {
+            goto error;
+        }
+        workspace->n_files++;
+        offset += size;
+    }
+    size_t n_assignments = 2 * workspace->n_comb;
+    size_t assignments_size = gsto_image_align8(n_assignments * sizeof(int32_t));
+    if(offset + header.n_overrides * sizeof(gsto_image_override) + assignments_size + header.n_data * sizeof(gsto_image_data) > image_size) {
+        goto error;
+    }
+    workspace->overrides = calloc(header.n_overrides + 1, sizeof(gsto_assignment));
+    for(i = 0; i < header.n_overrides; i++) {
+        const gsto_image_override *o = (const gsto_image_override *)(image + offset) + i;
+        if(o->file >= workspace->n_files) {
+            goto error;
+        }
+        workspace->overrides[i].Z1 = o->Z1;
+        workspace->overrides[i].Z2 = o->Z2;
+        workspace->overrides[i].file = &workspace->files[o->file];
+    }
+    offset += header.n_overrides * sizeof(gsto_image_override);
+    const int32_t *assignments = (const int32_t *)(image + offset);
+    for(i = 0; i < n_assignments; i++) {
+        if(assignments[i] < -1 || assignments[i] >= (int64_t)workspace->n_files) {
+            goto error;
+        }
+        gsto_file_t *file = assignments[i] < 0 ? NULL : &workspace->files[assignments[i]];
+        if(i < workspace->n_comb) {
+            workspace->stop_assignments[i] = file;
         } else {
-            fprintf(stderr, "WARNING: adding stopping file failed, since line %i in %s is malformed.\n", lineno, file);
-            n_errors++;
+            workspace->stragg_assignments[i - workspace->n_comb] = file;
         }
-        if(file != columns[1] && file) { /* Free filename if it was allocated */
-            free(file);
+    }
+    offset += assignments_size;
+    const gsto_image_data *entries = (const gsto_image_data *)(image + offset);
+    offset += header.n_data * sizeof(gsto_image_data);
+    size_t data_start = (offset + GSTO_IMAGE_ALIGN - 1) / GSTO_IMAGE_ALIGN * GSTO_IMAGE_ALIGN;
+    for(i = 0; i < header.n_data; i++) {
+        const gsto_image_data *d = &entries[i];
+        if(d->file >= workspace->n_files) {
+            goto error;
+        }
+        gsto_file_t *file = &workspace->files[d->file];
+        if(!file->data || d->i_comb >= file->n_comb || d->offset % GSTO_IMAGE_ALIGN || d->offset > image_size ||
+           data_start + d->offset + file->xpoints * sizeof(double) > image_size) {
+            goto error;
+        }
+        const double *data = (const double *)(image + data_start + d->offset);
+        gsto_file_store_lookup(file, d->i_comb, data); /* Nothing is resampled or interleaved yet, but this is cheap then */
+        file->data[d->i_comb] = (double *)data; /* Like mapped containers, data must not be modified */
+    }
+    for(i = 0; i < workspace->n_files; i++) {
+        gsto_file_t *file = &workspace->files[i];
+        if(file->data && file->data_format == GSTO_DF_CONTAINER && !gsto_file_load_data(workspace, file)) { /* Mapped again */
+            goto error;
         }
     }
+    return workspace;
+error:
 #ifdef DEBUG
-    fprintf(stderr, "GSTO: Read %i lines from settings file, added %i files, attempt to add %i files failed.\n", lineno, n_files, n_errors);
+    fprintf(stderr, "GSTO image is not valid (any more).\n");
 #endif
-    fclose(f);
-    free(line);
-    return n_files;
+    jibal_gsto_free(workspace);
+    return NULL;
 }
 
-gsto_assignment *jibal_gsto_read_assignments_file(jibal_gsto *workspace, const char *filename) {
-    if(!filename) {
-        fprintf(stderr, "WARNING: No assignments filename given. Maybe you don't have %s anywhere? Create an empty file to suppress this warning.\n", JIBAL_ASSIGNMENTS_FILE);
-        return NULL;
+static int gsto_manifest_make_header(gsto_manifest_header *header, const char *files_file_name, size_t n_files, size_t n_rejected) { /* Header corresponding to the current state of the settings file */
+    struct stat st;
+    if(!files_file_name || stat(files_file_name, &st)) {
+        return 0;
     }
-    FILE *f = fopen(filename, "r");
-    if (!f) {
-        fprintf(stderr, "WARNING: Can not open file %s. Create an empty file to suppress this warning.\n", filename);
-        return NULL;
+    memset(header, 0, sizeof(gsto_manifest_header));
+    memcpy(header->magic, GSTO_MANIFEST_MAGIC, sizeof(header->magic));
+    header->version = GSTO_MANIFEST_VERSION;
+    header->endian_check = GSTO_MANIFEST_ENDIAN_CHECK;
+    header->settings_size = st.st_size;
+    header->settings_mtime = st.st_mtime;
+    header->settings_path_length = strlen(files_file_name);
+    header->n_files = n_files;
+    header->n_rejected = n_rejected;
+    return 1;
+}
+
+static void gsto_manifest_make_rejected(gsto_manifest_rejected *r, const char *filename) {
+    struct stat st;
+    memset(r, 0, sizeof(gsto_manifest_rejected));
+    r->filename_length = strlen(filename);
+    if(stat(filename, &st) == 0) {
+        r->exists = TRUE;
+        r->file_size = st.st_size;
+        r->file_mtime = st.st_mtime;
     }
-    char *line = NULL;
-    char *line_split;
-    char *columns[3];
-    char **col;
-    int lineno = 0, n_possible = 0, n_actual = 0;
-    size_t line_size=0;
-    while(getline(&line, &line_size, f) > 0) { if (line[0] != '#') { n_possible++; }}
-    if (n_possible == 0) {
-        free(line);
-        return NULL;
+}
+
+static size_t gsto_manifest_rejected_read(jibal_gsto *workspace, const char *record, size_t size) { /* Returns the size of the record, 0 if it is not valid or the file has changed */
+    gsto_manifest_rejected r, expected;
+    if(size < sizeof(gsto_manifest_rejected)) {
+        return 0;
     }
-    rewind(f);
-    gsto_assignment *a = calloc(n_possible, sizeof(gsto_assignment));
-    while(getline(&line, &line_size, f) > 0) {
-        lineno++;
-        if (line[0] == '#') /* Strip comments */
-            continue;
-        line_split = line; /* strsep will screw up line_split, reset for every new line */
-        /* We read in two columns (hard coded), first is the name and the second is the filename. */
-        for (col = columns; col < &columns[3]; col++) { *col = NULL; }
-        for (col = columns; (*col = strsep(&line_split, ",\t\r\n")) != NULL;) {
-            if (**col != '\0')
-                if (++col >= &columns[3])
-                    break;
-        }
-        const jibal_element *incident = jibal_element_find(workspace->elements, columns[0]);
-        if (!incident) {
-            fprintf(stderr, "WARNING: No such element: %s in file %s", columns[0], filename);
-            continue;
+    memcpy(&r, record, sizeof(gsto_manifest_rejected));
+    size_t record_size = sizeof(gsto_manifest_rejected) + gsto_image_align8(r.filename_length);
+    if(r.filename_length == 0 || record_size > size) {
+        return 0;
+    }
+    char *filename = gsto_record_string(record + sizeof(gsto_manifest_rejected), r.filename_length);
+    gsto_manifest_make_rejected(&expected, filename);
+    if(memcmp(&r, &expected, sizeof(gsto_manifest_rejected)) != 0) {
+        free(filename);
+        return 0;
+    }
+    gsto_add_rejected(workspace, filename);
+    free(filename);
+    return record_size;
+}
+
+int jibal_gsto_manifest_read(jibal_gsto *workspace, const char *manifest_file_name, const char *files_file_name) {
+    gsto_manifest_header header, expected;
+    if(!manifest_file_name || workspace->parent || workspace->n_views) {
+        return 0;
+    }
+    FILE *f = fopen(manifest_file_name, "rb");
+    if(!f) {
+        return 0;
+    }
+    char *manifest = NULL;
+    long size = -1;
+    if(!fseek(f, 0, SEEK_END) && (size = ftell(f)) >= (long)sizeof(gsto_manifest_header) && !fseek(f, 0, SEEK_SET)) {
+        manifest = malloc(size);
+        if(fread(manifest, 1, size, f) != (size_t)size) { /* Everything with one read */
+            free(manifest);
+            manifest = NULL;
         }
-        const jibal_element *target = jibal_element_find(workspace->elements, columns[1]);
-        if (!target) {
-            fprintf(stderr, "WARNING: No such element: %s in file %s", columns[1], filename);
-            continue;
+    }
+    fclose(f);
+    if(!manifest) {
+        return 0;
+    }
+    memcpy(&header, manifest, sizeof(gsto_manifest_header));
+    size_t offset = sizeof(gsto_manifest_header) + gsto_image_align8(header.settings_path_length);
+    if(!gsto_manifest_make_header(&expected, files_file_name, header.n_files, header.n_rejected) || memcmp(&header, &expected, sizeof(gsto_manifest_header)) != 0 ||
+       offset > (size_t)size || memcmp(manifest + sizeof(gsto_manifest_header), files_file_name, header.settings_path_length) != 0 || header.n_files > (size_t)size || header.n_rejected > (size_t)size) {
+#ifdef DEBUG
+        fprintf(stderr, "GSTO manifest %s is not valid (any more).\n", manifest_file_name);
+#endif
+        free(manifest);
+        return 0;
+    }
+    size_t n_files_old = workspace->n_files, n_rejected_old = workspace->n_rejected, i;
+    workspace->files = realloc(workspace->files, sizeof(gsto_file_t) * (n_files_old + header.n_files));
+    for(i = 0; i < header.n_files; i++) {
+        size_t record_size = jibal_gsto_file_record_read(&workspace->files[workspace->n_files], manifest + offset, size - offset);
+        if(!record_size) { /* A file has changed, headers of all files will be read again */
+            goto error;
         }
-        gsto_file_t *file = jibal_gsto_get_file(workspace, columns[2]);
-        if (!file) {
-            fprintf(stderr, "WARNING: No such GSTO file: %s in file %s", columns[2], filename);
-            continue;
+        workspace->n_files++;
+        offset += record_size;
+    }
+    for(i = 0; i < header.n_rejected; i++) {
+        size_t record_size = gsto_manifest_rejected_read(workspace, manifest + offset, size - offset);
+        if(!record_size) { /* A file that could not be added has changed (or appeared), maybe it can be added now */
+            goto error;
         }
-        gsto_assignment *ass = &a[n_actual];
-        ass->Z1 = incident->Z;
-        ass->Z2 = target->Z;
-        ass->file = file;
-        n_actual++;
+        offset += record_size;
     }
-    free(line);
-    return a; /* Remember to free this */
+    free(manifest);
+    return header.n_files;
+error:
+    while(workspace->n_files > n_files_old) {
+        workspace->n_files--;
+        jibal_gsto_file_free(&workspace->files[workspace->n_files]);
+    }
+    while(workspace->n_rejected > n_rejected_old) {
+        workspace->n_rejected--;
+        free(workspace->rejected[workspace->n_rejected]);
+    }
+    free(manifest);
+    return 0;
+}
+
+int jibal_gsto_manifest_write(const jibal_gsto *workspace, const char *manifest_file_name, const char *files_file_name) {
+    gsto_manifest_header header;
+    if(!manifest_file_name || workspace->n_files == 0 || !gsto_manifest_make_header(&header, files_file_name, workspace->n_files, workspace->n_rejected)) {
+        return 0;
+    }
+    char *filename_tmp;
+    FILE *f = jibal_fopen_tmp(manifest_file_name, &filename_tmp);
+    if(!f) { /* Directory is probably not writable, that is fine. */
+        return 0;
+    }
+    int success = (fwrite(&header, sizeof(gsto_manifest_header), 1, f) == 1 && fwrite(files_file_name, 1, header.settings_path_length, f) == header.settings_path_length &&
+                   gsto_fprint_padding(f, gsto_image_align8(header.settings_path_length) - header.settings_path_length));
+    size_t i;
+    for(i = 0; success && i < workspace->n_files; i++) {
+        success = jibal_gsto_file_record_write(f, &workspace->files[i], FALSE);
+    }
+    for(i = 0; success && i < workspace->n_rejected; i++) {
+        gsto_manifest_rejected r;
+        gsto_manifest_make_rejected(&r, workspace->rejected[i]);
+        success = (fwrite(&r, sizeof(gsto_manifest_rejected), 1, f) == 1 && fwrite(workspace->rejected[i], 1, r.filename_length, f) == r.filename_length &&
+                   gsto_fprint_padding(f, gsto_image_align8(r.filename_length) - r.filename_length));
+    }
+    if(fclose(f)) {
+        success = FALSE;
+    }
+#ifdef WIN32
+    remove(manifest_file_name); /* rename() doesn't replace on Windows */
+#endif
+    if(!success || rename(filename_tmp, manifest_file_name)) {
+        remove(filename_tmp);
+        success = FALSE;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Writing GSTO manifest %s %s.\n", manifest_file_name, success ? "succeeded" : "failed");
+#endif
+    free(filename_tmp);
+    return success;
 }
 
 
@@ -1099,11 +3190,7 @@ double jibal_gsto_stop_nuclear_universal(double E, int Z1, double m1, int Z2, do
 #ifdef DEBUG_VERBOSE
     fprintf(stderr, "Nuclear stopping of Z2=%i (m2=%g) for Z1=%i (m2=%g). a_u=%g, gamma=%g, epsilon=%g\n", Z2, m2, Z1, m2, a_u, gamma, epsilon);
 #endif
-    if(epsilon <= 30.0) {
-         S_ne=log(1+1.1383*epsilon)/(2*(epsilon+0.01321*pow(epsilon, 0.21226)+0.19593*pow(epsilon, 0.5)));
-    } else {
-         S_ne=log(epsilon)/(2*epsilon);
-    }
+    S_ne = jibal_stop_nuc_reduced(epsilon);
     double S=S_ne*C_PI*pow(a_u, 2.0)*gamma*E/epsilon;
 #ifdef DEBUG_VERBOSE
     fprintf(stderr, "Reduced S_ne=%g, S=%g (eV/tfu)\n", S_ne, S/C_EV_TFU);
@@ -1125,6 +3212,60 @@ gsto_file_t *jibal_gsto_get_assigned_file(const jibal_gsto *workspace, gsto_stop
     return NULL;
 }
 
+static const gsto_file_t *gsto_cache_get_loaded_file(const jibal_gsto *workspace, gsto_file_t *file, int Z1, int Z2) { /* Lookup of an
+ * evictable file. Evicted (or not yet loaded) combinations are loaded, also without lazy loading. */
+    jibal_gsto *database = workspace->parent ? workspace->parent : (jibal_gsto *) workspace;
+    jibal_gsto *w = (jibal_gsto *) workspace; /* Statistics only, a workspace is used by one thread at a time */
+    size_t i = jibal_gsto_file_get_data_index(file, Z1, Z2);
+    size_t epoch = jibal_atomic_load_size(&database->cache_epoch);
+    double **data = jibal_atomic_load_ptr(&file->data);
+    int loaded = FALSE;
+    if(data && jibal_atomic_load_ptr(&data[i])) {
+        w->cache_hits++;
+    } else {
+        w->cache_misses++;
+        if(!jibal_gsto_load_combination(workspace, file, Z1, Z2)) {
+            return NULL;
+        }
+        loaded = TRUE;
+    }
+    size_t *last_use = jibal_atomic_load_ptr(&file->last_use);
+    if(last_use && jibal_atomic_load_size(&last_use[i]) != epoch) { /* Avoids writing to a shared cache line on every lookup */
+        jibal_atomic_store_size(&last_use[i], epoch);
+    }
+    if(loaded && database->cache_budget) {
+        size_t bytes = jibal_atomic_add_size(&database->cache_loaded, gsto_file_combination_size(file, i));
+        if(bytes > database->cache_budget) {
+            gsto_cache_auto_trim(database);
+        }
+    }
+    return file;
+}
+
+const gsto_file_t *jibal_gsto_get_loaded_file(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2) {
+    gsto_file_t *file = jibal_gsto_get_assigned_file(workspace, type, Z1, Z2);
+    if(!file) {
+        if(!workspace->lazy || !jibal_gsto_auto_assign((jibal_gsto *) workspace, Z1, Z2)) { /* Only the assignments (of this view) are modified */
+            return NULL;
+        }
+        file = jibal_gsto_get_assigned_file(workspace, type, Z1, Z2);
+        if(!file) {
+            return NULL;
+        }
+    }
+    if(file->evictable) {
+        return gsto_cache_get_loaded_file(workspace, file, Z1, Z2);
+    }
+    double **data = jibal_atomic_load_ptr(&file->data);
+    if(data && jibal_atomic_load_ptr(&data[jibal_gsto_file_get_data_index(file, Z1, Z2)])) {
+        return file;
+    }
+    if(workspace->lazy && jibal_gsto_load_combination(workspace, file, Z1, Z2)) {
+        return file;
+    }
+    return NULL;
+}
+
 gsto_file_t *jibal_gsto_get_file(const jibal_gsto *workspace, const char *name) {
     size_t i;
     gsto_file_t *file;
@@ -1250,33 +3391,88 @@ fprintf(stderr, "em = %g, lo=%zu, residual=%e m/s (%.2lf%% of bin)\n", em
         return -1;
     }
 #endif
+    if(lo >= file->xpoints - 1) { /* em is the last point (or very close to it), interpolation needs lo+1 */
+        lo = file->xpoints - 2;
+    }
 
     return lo;
 }
 
-double jibal_gsto_get_em(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, double em) {
-    const gsto_file_t *file = jibal_gsto_get_assigned_file(workspace, type, Z1, Z2);
-    assert(file);
-    assert(file->data);
+static inline const double *gsto_file_get_resampled_data(const gsto_file_t *file, int Z1, int Z2) { /* NULL if not resampled */
+    if(!file->rs_data) {
+        return NULL;
+    }
+    return jibal_atomic_load_ptr(&file->rs_data[jibal_gsto_file_get_data_index(file, Z1, Z2)]);
+}
+
+static inline const gsto_point *gsto_file_get_interleaved_data(const gsto_file_t *file, int Z1, int Z2) { /* NULL if not interleaved */
+    if(!file->il_data) {
+        return NULL;
+    }
+    return jibal_atomic_load_ptr(&file->il_data[jibal_gsto_file_get_data_index(file, Z1, Z2)]);
+}
+
+static inline double gsto_point_interpolate(const gsto_point *p, double em) { /* p is the lower point of the bin */
+    return p->y + p->slope * (em - p->em);
+}
+
+static const gsto_file_t *gsto_get_loaded_data(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, const double **data) { /* Same as
+ * jibal_gsto_get_loaded_file(), also gets the data. Data of an evictable file can be evicted by another thread right after
+ * the lookup, then we look it up (and load it) again. */
+    const gsto_file_t *file;
+    do {
+        file = jibal_gsto_get_loaded_file(workspace, type, Z1, Z2);
+        *data = file ? jibal_atomic_load_ptr(&file->data[jibal_gsto_file_get_data_index(file, Z1, Z2)]) : NULL;
+    } while(file && !*data);
+    return file;
+}
+
+static double gsto_get_em(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, double em) { /* See jibal_gsto_get_em(), workspace must be pinned */
+    const double *data;
+    const gsto_file_t *file = gsto_get_loaded_data(workspace, type, Z1, Z2, &data);
+    if(!file) {
+        assert(workspace->lazy); /* Stopping must be assigned and loaded, unless lazy loading is used */
+        return 0.0;
+    }
 #ifdef DEBUG_VERBOSE
     fprintf(stderr, "jibal_gsto_get_em(%p, type = %i, Z1 = %i, Z2 = %i, em = %e (%g keV/u)). File is %s.\n", (void *)workspace, type, Z1, Z2, em, em/(C_KEV/C_U), file->name);
 #endif
-    const double *data = jibal_gsto_file_get_data(file, Z1, Z2);
-    assert(data);
-    int lo = jibal_gsto_em_to_index(file, em);
-    if(lo < 0) { /* Out of bounds */
-        if(workspace->extrapolate) {
-            if(em >= 0 && em <= file->em[0]) {
-                return jibal_linear_interpolation(0.0, file->em[0], 0.0, data[0], em);
-                /* Linear interpolation from (0, 0) to the lowest real data point */
-            }
-            if(em >= file->em[file->xpoints - 1]) {
-                return data[file->xpoints - 1];
+    const double *rs = gsto_file_get_resampled_data(file, Z1, Z2);
+    const gsto_point *il = gsto_file_get_interleaved_data(file, Z1, Z2); /* On the same grid as lookups */
+    const int single = file->single;
+    const double scale = single ? file->single_scale[jibal_gsto_file_get_data_index(file, Z1, Z2)] : 1.0;
+    double out;
+    if(rs && em >= file->rs_em[0] && em <= file->rs_em[file->rs_points - 1]) { /* Uniform log grid, no unit conversions or searching */
+        size_t lo = (log(em) - file->rs_log_em_min) * file->rs_div;
+        if(lo > file->rs_points - 2) {
+            lo = file->rs_points - 2;
+        }
+        if(il) {
+            out = gsto_point_interpolate(&il[lo], em);
+        } else {
+            out = jibal_linear_interpolation(file->rs_em[lo], file->rs_em[lo+1], gsto_data_at(rs, single, lo), gsto_data_at(rs, single, lo+1), em);
+        }
+    } else {
+        int lo = jibal_gsto_em_to_index(file, em);
+        if(lo < 0) { /* Out of bounds */
+            if(workspace->extrapolate) {
+                if(em >= 0 && em <= file->em[0]) {
+                    return scale * jibal_linear_interpolation(0.0, file->em[0], 0.0, gsto_data_at(data, single, 0), em);
+                    /* Linear interpolation from (0, 0) to the lowest real data point */
+                }
+                if(em >= file->em[file->xpoints - 1]) {
+                    return scale * gsto_data_at(data, single, file->xpoints - 1);
+                }
             }
+            return 0.0;
+        }
+        if(il && !rs) {
+            out = gsto_point_interpolate(&il[lo], em);
+        } else {
+            out = jibal_linear_interpolation(file->em[lo], file->em[lo+1], gsto_data_at(data, single, lo), gsto_data_at(data, single, lo+1), em);
         }
-        return 0.0;
     }
-    double out = jibal_linear_interpolation(file->em[lo], file->em[lo+1], data[lo], data[lo+1], em);
+    out *= scale;
     if(file->straggunit == GSTO_STRAGG_UNIT_BOHR) {
         assert(type == GSTO_STO_STRAGG);
         out *= jibal_stragg_bohr(Z1, Z2);
@@ -1287,6 +3483,241 @@ double jibal_gsto_get_em(const jibal_gsto *workspace, gsto_stopping_type type, i
     return out;
 }
 
+double jibal_gsto_get_em(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, double em) {
+    jibal_gsto_cache_pin(workspace);
+    double out = gsto_get_em(workspace, type, Z1, Z2, em);
+    jibal_gsto_cache_unpin(workspace);
+    return out;
+}
+
+static double gsto_unit_factor(const gsto_file_t *file, int Z1, int Z2) { /* Correction for data that hasn't been converted to SI */
+    if(file->straggunit == GSTO_STRAGG_UNIT_BOHR) {
+        return jibal_stragg_bohr(Z1, Z2);
+    } else if(file->stounit == GSTO_STO_UNIT_EV15CM2) {
+        return C_EV_TFU;
+    }
+    return 1.0;
+}
+
+static double gsto_x_from_em_factor(gsto_xunit xunit) { /* Linear conversion from em to x, 0.0 if not linear (m/s) */
+    switch(xunit) {
+        case GSTO_X_UNIT_J_KG:
+            return 1.0;
+        case GSTO_X_UNIT_MEV_U:
+            return 1.0/(C_MEV/C_U);
+        case GSTO_X_UNIT_KEV_U:
+            return 1.0/(C_KEV/C_U);
+        default:
+            return 0.0;
+    }
+}
+
+static void gsto_file_get_em_many(const jibal_gsto *workspace, const gsto_file_t *file, const double *data_orig, int Z1, int Z2, const double *em, double *out, size_t n) {
+    /* Kernel for jibal_gsto_get_em_many(). Decisions depending on the file (units, scale) are made once, not for every
+     * point. The index computation is done in a separate pass (using out as temporary storage) so that it can be
+     * vectorized. Out of range points are handled like jibal_gsto_get_em() does. */
+    const double *rs = gsto_file_get_resampled_data(file, Z1, Z2);
+    const double *data = rs ? rs : data_orig;
+    const gsto_point *il = gsto_file_get_interleaved_data(file, Z1, Z2);
+    const double *e = rs ? file->rs_em : file->em;
+    const size_t last = (rs ? file->rs_points : file->xpoints) - 1;
+    const double em_first = e[0], em_last = e[last];
+    const int single = file->single;
+    const double f = gsto_unit_factor(file, Z1, Z2) * (single ? file->single_scale[jibal_gsto_file_get_data_index(file, Z1, Z2)] : 1.0);
+    const double xconv = gsto_x_from_em_factor(file->xunit);
+    size_t i, lo = 0;
+    assert(data);
+    if(rs) {
+        for(i = 0; i < n; i++) {
+            out[i] = (log(em[i]) - file->rs_log_em_min) * file->rs_div;
+        }
+    } else switch(file->xscale) {
+        case GSTO_XSCALE_LOG10:
+            if(xconv != 0.0) {
+                const double offset = log10(xconv) - file->xmin_speedup;
+                for(i = 0; i < n; i++) {
+                    out[i] = (log10(em[i]) + offset) * file->xdiv;
+                }
+            } else {
+                for(i = 0; i < n; i++) {
+                    out[i] = (log10(jibal_velocity_from_em(em[i])) - file->xmin_speedup) * file->xdiv;
+                }
+            }
+            break;
+        case GSTO_XSCALE_LINEAR:
+            if(xconv != 0.0) {
+                for(i = 0; i < n; i++) {
+                    out[i] = (em[i] * xconv - file->xmin) * file->xdiv;
+                }
+            } else {
+                for(i = 0; i < n; i++) {
+                    out[i] = (jibal_velocity_from_em(em[i]) - file->xmin) * file->xdiv;
+                }
+            }
+            break;
+        case GSTO_XSCALE_ARBITRARY:
+        default:
+            for(i = 0; i < n; i++) { /* Binary search, but try the previous bin first (input is often sorted) */
+                double x = em[i];
+                if(!(x >= e[lo] && x < e[lo + 1])) {
+                    size_t hi = last;
+                    lo = 0;
+                    while(hi - lo > 1) {
+                        size_t mi = (hi + lo) / 2;
+                        if(x >= e[mi]) {
+                            lo = mi;
+                        } else {
+                            hi = mi;
+                        }
+                    }
+                }
+                out[i] = lo;
+            }
+            break;
+    }
+    for(i = 0; i < n; i++) {
+        double x = em[i];
+        if(!(x >= em_first && x <= em_last)) { /* Out of bounds (or NaN) */
+            double y = 0.0;
+            if(workspace->extrapolate) {
+                if(x >= 0.0 && x <= em_first) {
+                    y = jibal_linear_interpolation(0.0, em_first, 0.0, gsto_data_at(data, single, 0), x);
+                } else if(x >= em_last) {
+                    y = gsto_data_at(data, single, last);
+                }
+            }
+            out[i] = y * f;
+            continue;
+        }
+        double t = out[i];
+        size_t j = t > 0.0 ? (size_t) t : 0; /* Truncation is floor() for non-negative numbers */
+        if(j >= last) {
+            j = last - 1;
+        }
+        if(il) {
+            out[i] = f * gsto_point_interpolate(&il[j], x);
+            continue;
+        }
+        double y_j = gsto_data_at(data, single, j), y_next = gsto_data_at(data, single, j + 1);
+        out[i] = f * (y_j + (x - e[j]) * (y_next - y_j) / (e[j + 1] - e[j]));
+    }
+}
+
+int jibal_gsto_get_em_many(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, const double *em, double *out, size_t n) {
+    const double *data;
+    jibal_gsto_cache_pin(workspace);
+    const gsto_file_t *file = gsto_get_loaded_data(workspace, type, Z1, Z2, &data);
+    if(file) {
+        gsto_file_get_em_many(workspace, file, data, Z1, Z2, em, out, n);
+    }
+    jibal_gsto_cache_unpin(workspace);
+    return file != NULL;
+}
+
+int jibal_gsto_get_em_many_Z2(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, const int *Z2, const double *em, double *out, size_t n) {
+    size_t i = 0;
+    while(i < n) { /* Runs of the same Z2 are evaluated with a single call to the kernel */
+        size_t j;
+        for(j = i + 1; j < n && Z2[j] == Z2[i]; j++);
+        if(!jibal_gsto_get_em_many(workspace, type, Z1, Z2[i], em + i, out + i, j - i)) {
+            return 0;
+        }
+        i = j;
+    }
+    return 1;
+}
+
+int jibal_gsto_cursor_init(jibal_gsto_cursor *cursor, const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2) {
+    const double *data;
+    jibal_gsto_cache_pin(workspace);
+    cursor->file = gsto_get_loaded_data(workspace, type, Z1, Z2, &data);
+    jibal_gsto_cache_unpin(workspace);
+    cursor->lo = 0;
+    cursor->extrapolate = workspace->extrapolate;
+    if(!cursor->file) {
+        cursor->em = NULL;
+        cursor->xpoints = 0;
+        cursor->data = NULL;
+        cursor->single = FALSE;
+        cursor->points = NULL;
+        cursor->factor = 0.0;
+        return 0;
+    }
+    cursor->data = gsto_file_get_resampled_data(cursor->file, Z1, Z2);
+    if(cursor->data) {
+        cursor->em = cursor->file->rs_em;
+        cursor->xpoints = cursor->file->rs_points;
+    } else {
+        cursor->data = data;
+        cursor->em = cursor->file->em;
+        cursor->xpoints = cursor->file->xpoints;
+    }
+    cursor->single = cursor->file->single;
+    cursor->points = gsto_file_get_interleaved_data(cursor->file, Z1, Z2);
+    cursor->factor = gsto_unit_factor(cursor->file, Z1, Z2);
+    if(cursor->single) {
+        cursor->factor *= cursor->file->single_scale[jibal_gsto_file_get_data_index(cursor->file, Z1, Z2)];
+    }
+    return 1;
+}
+
+int jibal_gsto_cursor_index(jibal_gsto_cursor *cursor, double em) {
+    const double *e = cursor->em;
+    const size_t last = cursor->xpoints - 1;
+    size_t lo = cursor->lo, hi;
+    int n;
+    if(!(em >= e[0] && em <= e[last])) { /* Out of bounds (or NaN) */
+        return -1;
+    }
+    if(em >= e[lo]) { /* Walk forward */
+        for(n = 0; n < JIBAL_GSTO_CURSOR_WALK && lo + 1 < last && em >= e[lo + 1]; n++) {
+            lo++;
+        }
+        hi = (lo + 1 < last && em >= e[lo + 1]) ? last : lo + 1;
+    } else { /* Walk backward, lo > 0 since em >= e[0] */
+        for(n = 0; n < JIBAL_GSTO_CURSOR_WALK && em < e[lo]; n++) {
+            lo--;
+        }
+        hi = lo + 1;
+        if(em < e[lo]) {
+            hi = lo;
+            lo = 0;
+        }
+    }
+    while(hi - lo > 1) { /* Binary search for long jumps, e[lo] <= em < e[hi] (or hi is the last point) */
+        size_t mi = (hi + lo) / 2;
+        if(em >= e[mi]) {
+            lo = mi;
+        } else {
+            hi = mi;
+        }
+    }
+    cursor->lo = lo;
+    return (int)lo;
+}
+
+double jibal_gsto_cursor_get_em(jibal_gsto_cursor *cursor, double em) {
+    if(!cursor->file) {
+        return 0.0;
+    }
+    int lo = jibal_gsto_cursor_index(cursor, em);
+    if(lo < 0) { /* Out of bounds */
+        if(cursor->extrapolate) {
+            if(em >= 0 && em <= cursor->em[0]) {
+                return cursor->factor * jibal_linear_interpolation(0.0, cursor->em[0], 0.0, jibal_gsto_cursor_data(cursor, 0), em);
+            }
+            if(em >= cursor->em[cursor->xpoints - 1]) {
+                return cursor->factor * jibal_gsto_cursor_data(cursor, cursor->xpoints - 1);
+            }
+        }
+        return 0.0;
+    }
+    if(cursor->points) {
+        return cursor->factor * gsto_point_interpolate(&cursor->points[lo], em);
+    }
+    return cursor->factor * jibal_linear_interpolation(cursor->em[lo], cursor->em[lo+1], jibal_gsto_cursor_data(cursor, lo), jibal_gsto_cursor_data(cursor, lo+1), em);
+}
+
 int jibal_gsto_assign_material(jibal_gsto *workspace, const jibal_isotope *incident, jibal_material *target, gsto_file_t *file) {
     size_t i;
     for (i = 0; i < target->n_elements; i++) {
@@ -18,12 +18,44 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 #include <jibal.h>
 #include <jibal_config.h>
 #include <jibal_defaults.h>
+#include <jibal_generic.h>
 #include "win_compat.h"
 
-jibal *jibal_init(const char *config_filename) {
+static void jibal_configure_gsto(jibal *jibal) { /* Settings of the configuration that are not used by jibal_gsto_init() */
+    jibal->gsto->extrapolate = jibal->config->extrapolate;
+    jibal->gsto->stop_tolerance = jibal->config->stop_tolerance;
+    jibal->gsto->lazy = jibal->config->lazy_loading;
+    jibal->gsto->write_index = jibal->config->index_files;
+    jibal->gsto->load_threads = jibal->config->load_threads;
+    if(jibal->config->single_precision) {
+        jibal_gsto_single_precision(jibal->gsto);
+    }
+    if(jibal->config->resample > 0) {
+        jibal_gsto_resample_tolerance(jibal->gsto, jibal->config->resample_tolerance);
+        jibal_gsto_resample(jibal->gsto, jibal->config->resample);
+    }
+    if(jibal->config->interleave) {
+        jibal_gsto_interleave(jibal->gsto, TRUE);
+    }
+}
+
+static char *jibal_userdata_filename(const jibal_config *config, const char *name) { /* Full path of a file in the user data directory. NULL if there is no user data directory. Caller must free. */
+    char *filename;
+    if(!config->userdatadir || asprintf(&filename, "%s/%s", config->userdatadir, name) < 0) {
+        return NULL;
+    }
+    return jibal_path_cleanup(filename);
+}
+
+static jibal *jibal_allocate() {
     jibal *jibal = malloc(sizeof(struct jibal));
     jibal->error = JIBAL_ERROR_NONE;
     jibal->units = NULL;
@@ -31,6 +63,13 @@ jibal *jibal_init(const char *config_filename) {
     jibal->elements = NULL;
     jibal->gsto = NULL;
     jibal->config = NULL;
+    jibal->image = NULL;
+    jibal->image_size = 0;
+    return jibal;
+}
+
+jibal *jibal_init(const char *config_filename) {
+    jibal *jibal = jibal_allocate();
     jibal->units=jibal_units_default();
     if(!jibal->units) {
         jibal->error = JIBAL_ERROR_UNITS;
@@ -41,16 +80,24 @@ jibal *jibal_init(const char *config_filename) {
         jibal->error = JIBAL_ERROR_CONFIG;
         return jibal;
     }
-    jibal->isotopes = jibal_isotopes_load(jibal->config->masses_file);
-    if(!jibal->isotopes) {
-        fprintf(stderr, "Could not load isotope table from file %s.\n", jibal->config->masses_file);
-        jibal->error = JIBAL_ERROR_MASSES;
-        return jibal;
-    }
-    if(jibal_abundances_load(jibal->isotopes, jibal->config->abundances_file) < 0) {
-        jibal->error = JIBAL_ERROR_ABUNDANCES;
-        return jibal;
+    char *masses_cache_file = jibal->config->masses_cache ? jibal_userdata_filename(jibal->config, JIBAL_MASSES_CACHE_FILE) : NULL;
+    jibal->isotopes = jibal_isotopes_cache_read(masses_cache_file, jibal->config->masses_file, jibal->config->abundances_file);
+    if(!jibal->isotopes) { /* No (valid) cache, parse the files */
+        jibal->isotopes = jibal_isotopes_load(jibal->config->masses_file);
+        if(!jibal->isotopes) {
+            fprintf(stderr, "Could not load isotope table from file %s.\n", jibal->config->masses_file);
+            jibal->error = JIBAL_ERROR_MASSES;
+            free(masses_cache_file);
+            return jibal;
+        }
+        if(jibal_abundances_load(jibal->isotopes, jibal->config->abundances_file) < 0) {
+            jibal->error = JIBAL_ERROR_ABUNDANCES;
+            free(masses_cache_file);
+            return jibal;
+        }
+        jibal_isotopes_cache_write(jibal->isotopes, masses_cache_file, jibal->config->masses_file, jibal->config->abundances_file);
     }
+    free(masses_cache_file);
     jibal->elements=jibal_elements_populate(jibal->isotopes);
 #ifdef DEBUG
     fprintf(stderr, "The Z_max of elements array is %d\n", jibal_elements_Zmax(jibal->elements));
@@ -59,14 +106,222 @@ jibal *jibal_init(const char *config_filename) {
         jibal->error = JIBAL_ERROR_ELEMENTS;
         return jibal;
     }
-    jibal->gsto= jibal_gsto_init(jibal->elements, jibal->config->Z_max, jibal->config->files_file,
-                                jibal->config->assignments_file);
+    char *gsto_manifest_file = jibal->config->gsto_manifest ? jibal_userdata_filename(jibal->config, JIBAL_GSTO_MANIFEST_FILE) : NULL;
+    jibal->gsto = jibal_gsto_init_manifest(jibal->elements, jibal->config->Z_max, jibal->config->files_file,
+                                jibal->config->assignments_file, gsto_manifest_file);
+    free(gsto_manifest_file);
     if(!jibal->gsto) {
         fprintf(stderr, "Could not initialize GSTO.\n");
         jibal->error = JIBAL_ERROR_GSTO;
         return jibal;
     }
-    jibal->gsto->extrapolate = jibal->config->extrapolate;
+    jibal_configure_gsto(jibal);
+    return jibal;
+}
+
+static const char *jibal_image_source_filename(const jibal_config *config, int i) {
+    switch(i) {
+        case 0:
+            return config->masses_file;
+        case 1:
+            return config->abundances_file;
+        case 2:
+            return config->files_file;
+        case 3:
+            return config->assignments_file;
+        default:
+            return NULL;
+    }
+}
+
+static void jibal_image_source_set(jibal_image_source *source, const char *filename) {
+    struct stat st;
+    memset(source, 0, sizeof(jibal_image_source));
+    if(!filename) {
+        return;
+    }
+    source->path_length = strlen(filename);
+    if(!stat(filename, &st)) {
+        source->file_size = st.st_size;
+        source->file_mtime = st.st_mtime;
+    }
+}
+
+static size_t jibal_image_align8(size_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+static int jibal_image_padding(FILE *f, size_t n) { /* Returns 0 if writing fails */
+    while(n--) {
+        if(fputc(0, f) == EOF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int jibal_image_write(const jibal *jibal, const char *filename, int with_data) {
+    if(!jibal || jibal->error || !filename) {
+        return 0;
+    }
+    jibal_image_header header;
+    memset(&header, 0, sizeof(jibal_image_header));
+    memcpy(header.magic, JIBAL_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = JIBAL_IMAGE_VERSION;
+    header.endian_check = JIBAL_IMAGE_ENDIAN_CHECK;
+    header.Z_max = jibal->config->Z_max;
+    header.with_data = with_data;
+    size_t n;
+    jibal_masses_cache_record *records = jibal_isotopes_to_records(jibal->isotopes, &n);
+    if(!records) {
+        return 0;
+    }
+    header.n_isotopes = n;
+    char *filename_tmp;
+    FILE *f = jibal_fopen_tmp(filename, &filename_tmp);
+    if(!f) {
+        free(records);
+        return 0;
+    }
+    int success = (fwrite(&header, sizeof(jibal_image_header), 1, f) == 1); /* Offsets and size are not known yet, header is written again at the end */
+    int i;
+    for(i = 0; success && i < JIBAL_IMAGE_N_SOURCES; i++) {
+        const char *source_filename = jibal_image_source_filename(jibal->config, i);
+        jibal_image_source source;
+        jibal_image_source_set(&source, source_filename);
+        success = (fwrite(&source, sizeof(jibal_image_source), 1, f) == 1);
+        if(success && source.path_length) {
+            success = (fwrite(source_filename, 1, source.path_length, f) == source.path_length &&
+                       jibal_image_padding(f, jibal_image_align8(source.path_length) - source.path_length));
+        }
+    }
+    header.isotopes_offset = ftell(f);
+    success = success && fwrite(records, sizeof(jibal_masses_cache_record), n, f) == n;
+    free(records);
+    header.gsto_offset = ftell(f);
+    success = success && jibal_gsto_image_write(f, jibal->gsto, with_data);
+    header.image_size = ftell(f);
+    success = success && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(jibal_image_header), 1, f) == 1;
+    if(fclose(f)) {
+        success = FALSE;
+    }
+#ifdef WIN32
+    remove(filename); /* rename() doesn't replace on Windows */
+#endif
+    if(!success || rename(filename_tmp, filename)) {
+        remove(filename_tmp);
+        success = FALSE;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Writing image %s %s.\n", filename, success ? "succeeded" : "failed");
+#endif
+    free(filename_tmp);
+    return success;
+}
+
+static int jibal_image_validate(const jibal *jibal) { /* Checks the header and sources of a mapped image against the configuration and the files as they are now */
+    const char *image = jibal->image;
+    jibal_image_header header;
+    if(jibal->image_size < sizeof(jibal_image_header)) {
+        return 0;
+    }
+    memcpy(&header, image, sizeof(jibal_image_header));
+    if(memcmp(header.magic, JIBAL_IMAGE_MAGIC, sizeof(header.magic)) != 0 || header.version != JIBAL_IMAGE_VERSION ||
+       header.endian_check != JIBAL_IMAGE_ENDIAN_CHECK || header.image_size != jibal->image_size || header.Z_max != jibal->config->Z_max) {
+        return 0;
+    }
+    if(header.isotopes_offset % 8 || header.n_isotopes > jibal->image_size || header.isotopes_offset + header.n_isotopes * sizeof(jibal_masses_cache_record) > jibal->image_size) {
+        return 0;
+    }
+    size_t offset = sizeof(jibal_image_header);
+    int i;
+    for(i = 0; i < JIBAL_IMAGE_N_SOURCES; i++) {
+        jibal_image_source source, expected;
+        const char *filename = jibal_image_source_filename(jibal->config, i);
+        if(offset + sizeof(jibal_image_source) > jibal->image_size) {
+            return 0;
+        }
+        memcpy(&source, image + offset, sizeof(jibal_image_source));
+        offset += sizeof(jibal_image_source);
+        jibal_image_source_set(&expected, filename);
+        if(memcmp(&source, &expected, sizeof(jibal_image_source)) != 0 || offset + source.path_length > jibal->image_size) {
+            return 0;
+        }
+        if(source.path_length && memcmp(image + offset, filename, source.path_length) != 0) {
+            return 0;
+        }
+        offset += jibal_image_align8(source.path_length);
+    }
+    return 1;
+}
+
+static void jibal_image_unmap(jibal *jibal) {
+    if(!jibal->image) {
+        return;
+    }
+#ifdef WIN32
+    free(jibal->image);
+#else
+    munmap(jibal->image, jibal->image_size);
+#endif
+    jibal->image = NULL;
+    jibal->image_size = 0;
+}
+
+jibal *jibal_init_from_image(const char *image_filename, const char *config_filename) {
+    if(!image_filename) {
+        return NULL;
+    }
+    FILE *f = fopen(image_filename, "rb");
+    if(!f) {
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fileno(f), &st) || st.st_size < (off_t)sizeof(jibal_image_header)) {
+        fclose(f);
+        return NULL;
+    }
+    jibal *jibal = jibal_allocate();
+    jibal->image_size = st.st_size;
+#ifdef WIN32
+    jibal->image = malloc(jibal->image_size);
+    if(fread(jibal->image, 1, jibal->image_size, f) != jibal->image_size) {
+        free(jibal->image);
+        jibal->image = NULL;
+    }
+#else
+    jibal->image = mmap(NULL, jibal->image_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if(jibal->image == MAP_FAILED) {
+        jibal->image = NULL;
+    }
+#endif
+    fclose(f); /* Mapping stays */
+    if(!jibal->image) {
+        jibal_free(jibal);
+        return NULL;
+    }
+    jibal->units = jibal_units_default(); /* Units are not in the image, they are built into the library anyway */
+    if(!jibal->units) {
+        jibal_free(jibal);
+        return NULL;
+    }
+    jibal->config = jibal_config_init(jibal->units, config_filename, TRUE);
+    if(jibal->config->error || !jibal_image_validate(jibal)) {
+#ifdef DEBUG
+        fprintf(stderr, "Image %s is not valid (any more).\n", image_filename);
+#endif
+        jibal_free(jibal);
+        return NULL;
+    }
+    const jibal_image_header *header = jibal->image;
+    jibal->isotopes = jibal_isotopes_from_records((const jibal_masses_cache_record *)((const char *)jibal->image + header->isotopes_offset), header->n_isotopes);
+    jibal->elements = jibal->isotopes ? jibal_elements_populate(jibal->isotopes) : NULL;
+    jibal->gsto = jibal->elements ? jibal_gsto_image_read(jibal->elements, jibal->image, jibal->image_size, header->gsto_offset) : NULL;
+    if(!jibal->gsto) {
+        jibal_free(jibal);
+        return NULL;
+    }
+    jibal_configure_gsto(jibal);
     return jibal;
 }
 
@@ -122,6 +377,7 @@ void jibal_free(jibal *jibal) {
     jibal_elements_free(jibal->elements);
     jibal_isotopes_free(jibal->isotopes);
     jibal_gsto_free(jibal->gsto);
+    jibal_image_unmap(jibal); /* After GSTO, data may point here */
     jibal_config_free(jibal->config);
     free(jibal);
 }
@@ -42,9 +42,36 @@ typedef struct jibal {
     jibal_element *elements;
     jibal_gsto *gsto;
     jibal_config *config;
+    void *image; /* Internal. Memory mapped image, if initialized with jibal_init_from_image(). Loaded data may point here. */
+    size_t image_size;
 } jibal; /* All in one solution */
 
+#define JIBAL_IMAGE_MAGIC "JIBALIM" /* Snapshot of an initialized jibal, see jibal_image_write() */
+#define JIBAL_IMAGE_VERSION 1
+#define JIBAL_IMAGE_ENDIAN_CHECK 0x01020304
+#define JIBAL_IMAGE_N_SOURCES 4 /* Masses, abundances, files and assignments files */
+
+typedef struct jibal_image_header { /* Image has this header followed by JIBAL_IMAGE_N_SOURCES sources (jibal_image_source), n_isotopes records (jibal_masses_cache_record) at isotopes_offset and the GSTO part (gsto_image_header) at gsto_offset */
+    char magic[8]; /* JIBAL_IMAGE_MAGIC, NUL terminated */
+    uint32_t version;
+    uint32_t endian_check; /* JIBAL_IMAGE_ENDIAN_CHECK, image is not portable */
+    uint64_t image_size;
+    int32_t Z_max;
+    int32_t with_data; /* boolean, loaded data is in the image */
+    uint64_t n_isotopes;
+    uint64_t isotopes_offset;
+    uint64_t gsto_offset;
+} jibal_image_header;
+
+typedef struct jibal_image_source { /* Followed by the filename (path_length bytes, not NUL terminated) and padding to a multiple of 8 bytes */
+    uint64_t file_size; /* Size and modification time of the file, image is not used if these (or the filename) change. Zero if the file doesn't exist. */
+    int64_t file_mtime;
+    uint64_t path_length; /* Zero if there is no file */
+} jibal_image_source;
+
 jibal *jibal_init(const char *config_filename);
+jibal *jibal_init_from_image(const char *image_filename, const char *config_filename); /* Like jibal_init(), but units, isotopes, elements and GSTO (files, assignments and data) come from an image made by jibal_image_write(). Image is memory mapped, loaded data is used from there. NULL if the image doesn't exist or it is not valid (any source file or Z_max has changed), then use jibal_init() (and jibal_image_write()). */
+int jibal_image_write(const jibal *jibal, const char *filename, int with_data); /* Writes an image of jibal (also loaded data if with_data is set). Returns 1 on success. */
 void jibal_status_print(FILE *f, const jibal *jibal);
 char *jibal_status_string(const jibal *jibal); /* Returns a newly allocated status string. */
 const char *jibal_config_filename(const jibal *jibal); /* Returns the filename (full path) where JIBAL configuration was actually (attempted to) read. */
@@ -29,10 +29,20 @@ typedef struct {
     char *userdatadir; /* e.g. ~/.jibal/ or %AppData/JIBAL */
     char *masses_file;
     char *abundances_file;
+    int masses_cache; /* boolean, isotopes are read from a binary image (JIBAL_MASSES_CACHE_FILE in userdatadir) if it is valid, see jibal_isotopes_cache_read() */
     char *files_file;
     char *assignments_file;
+    int gsto_manifest; /* boolean, headers of GSTO files are read from a manifest (JIBAL_GSTO_MANIFEST_FILE in userdatadir) if it is valid, see jibal_gsto_manifest_read() */
     int Z_max;
     int extrapolate; /* this is boolean, see JIBAL_CONFIG_VAR_BOOL */
+    double stop_tolerance; /* relative tolerance of adaptive step in layer energy loss, zero for fixed step */
+    int lazy_loading; /* boolean, stopping is assigned and loaded automatically on first use */
+    int load_threads; /* Number of threads used by jibal_gsto_load_all() */
+    int resample; /* Points per decade, see jibal_gsto_resample(). 0 disables resampling. */
+    double resample_tolerance; /* Largest relative error of resampled data, see jibal_gsto_resample_tolerance(). 0 disables the check. */
+    int single_precision; /* boolean, see jibal_gsto_single_precision() */
+    int interleave; /* boolean, see jibal_gsto_interleave() */
+    int index_files; /* boolean, index files of ASCII stopping files are written (and reused on subsequent runs) */
     jibal_cross_section_type cs_rbs;
     jibal_cross_section_type cs_erd;
 } jibal_config; /* Some internal configuration (environment etc) */
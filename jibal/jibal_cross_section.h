@@ -35,10 +35,36 @@ static const jibal_option jibal_cs_types[] = {
         {NULL, 0}
 };
 
+typedef struct jibal_cross_section { /* Energy independent part of a cross section for a fixed incident, target and angle */
+    jibal_cross_section_type type;
+    const jibal_isotope *incident;
+    const jibal_isotope *target;
+    double angle; /* Scattering angle theta (RBS) or recoil angle phi (ERD), lab */
+    double theta_cm;
+    double E_cm_factor; /* E_cm = E_cm_factor * E */
+    double sigma_factor; /* Rutherford cross section (lab) is sigma_factor / E^2 */
+    double andersen_a; /* Andersen correction r_VE = andersen_a / E */
+    double andersen_b; /* 0.5/sin(theta_cm/2) */
+} jibal_cross_section;
+
 double jibal_cross_section_rbs(const jibal_isotope *incident, const jibal_isotope *target, double theta, double E, jibal_cross_section_type type);
 double jibal_cross_section_erd(const jibal_isotope *incident, const jibal_isotope *target, double phi, double E, jibal_cross_section_type type);
 double jibal_andersen_correction(int z1, int z2, double E_cm, double theta_cm);
 
+int jibal_cross_section_rbs_init(jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double theta, jibal_cross_section_type type); /* Returns 0 if scattering to theta is kinematically impossible. */
+int jibal_cross_section_erd_init(jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double phi, jibal_cross_section_type type); /* Returns 0 if phi is not below 90 degrees. */
+inline double jibal_cross_section_get(const jibal_cross_section *cs, double E) { /* Same result as jibal_cross_section_rbs() or jibal_cross_section_erd() with the parameters given to init */
+    double E_inv = 1.0/E;
+    double sigma = cs->sigma_factor * E_inv * E_inv;
+    if(cs->type != JIBAL_CS_ANDERSEN)
+        return sigma;
+    double r_VE = cs->andersen_a * E_inv;
+    double b = cs->andersen_b * r_VE;
+    double F = (1.0 + 0.5 * r_VE) / (1.0 + r_VE + b * b);
+    return sigma * F * F;
+}
+void jibal_cross_section_get_many(const jibal_cross_section *cs, const double *E, double *sigma, size_t n); /* Evaluates n energies E, results to sigma */
+
 const char *jibal_cross_section_name(jibal_cross_section_type type);
 
 #endif /* _JIBAL_CROSS_SECTION_H_ */
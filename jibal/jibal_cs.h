@@ -26,6 +26,8 @@
 
 double jibal_cs_rbs(const jibal_config *config, const jibal_isotope *incident, const jibal_isotope *target, double theta, double E);
 double jibal_cs_erd(const jibal_config *config, const jibal_isotope *incident, const jibal_isotope *target, double phi, double E);
+int jibal_cs_rbs_init(const jibal_config *config, jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double theta); /* See jibal_cross_section_rbs_init() */
+int jibal_cs_erd_init(const jibal_config *config, jibal_cross_section *cs, const jibal_isotope *incident, const jibal_isotope *target, double phi);
 
 const char *jibal_cs_rbs_name(const jibal_config *config); /* Name of used cross sections */
 const char *jibal_cs_erd_name(const jibal_config *config); /* Name of used cross sections */
@@ -20,10 +20,15 @@
 
 #include <stdio.h>
 
+#define JIBAL_FOPEN_TMP_ATTEMPTS 100 /* jibal_fopen_tmp() gives up after this many names that are in use */
+#define JIBAL_STRTOD_MAX_LENGTH 128 /* Numbers that don't take the fast path of jibal_strtod() can be this long */
+
 int jibal_isdigit(char c);
 FILE *jibal_fopen(const char *filename, const char *mode); /* opens file and returns file pointer (like fopen()), returns NULL if fails, stderr if filename is NULL, stdout if filename is "-" */
 void jibal_fclose(FILE *f); /* fclose() unless f is either stdin, stdout or stderr */
+FILE *jibal_fopen_tmp(const char *filename, char **filename_tmp); /* Opens a new file for writing (binary) with a unique name next to filename, so that concurrent writers don't clobber each other. Write it and rename() it to filename. The name is stored in filename_tmp (caller must free). NULL if fails. */
 char *jibal_strsep(char **stringp, const char *delim); /* Just regular strsep */
 char *jibal_strsep_with_quotes(char **stringp, const char *delim);
 char *jibal_remove_double_quotes(char *s);
+double jibal_strtod(const char *nptr, char **endptr); /* Like strtod(), but the decimal point is always '.' regardless of locale. Typical numbers are converted without calling strtod(), results are identical. */
 #endif // JIBAL_GENERIC_H
@@ -19,6 +19,7 @@
 #define JIBAL_GSTO_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include <jibal_masses.h>
 #include <jibal_option.h>
 
@@ -70,16 +71,35 @@ static const jibal_option gsto_stragg_units[] = {
 typedef enum {
     GSTO_DF_NONE=0,
     GSTO_DF_ASCII=1,
-    GSTO_DF_DOUBLE=2
+    GSTO_DF_DOUBLE=2,
+    GSTO_DF_CONTAINER=3 /* Memory mappable, see gsto_container_header */
 } gsto_data_format;
 
 static const jibal_option gsto_data_formats[] = {
         {GSTO_STR_NONE, GSTO_DF_NONE},
         {"ascii", GSTO_DF_ASCII},
         {"binary", GSTO_DF_DOUBLE},
+        {"container", GSTO_DF_CONTAINER},
         {NULL, 0}
 };
 
+#define GSTO_CONTAINER_MAGIC "GSTOCONT"
+#define GSTO_CONTAINER_VERSION 1
+#define GSTO_CONTAINER_ENDIAN_CHECK 0x01020304
+#define GSTO_CONTAINER_ALIGN 64 /* Container header and each combination in the payload start at a multiple of this (bytes, from the beginning of the file) */
+
+typedef struct gsto_container_header { /* Follows the (text) headers and the x table of a GSTO file with format=container, at the next aligned offset. */
+    char magic[8]; /* GSTO_CONTAINER_MAGIC, not NUL terminated */
+    uint32_t version;
+    uint32_t endian_check; /* GSTO_CONTAINER_ENDIAN_CHECK in the byte order of the machine that wrote the file */
+    uint64_t n_comb; /* Must match the Z1, Z2 range in headers */
+    uint64_t xpoints; /* Must match x-points header */
+    uint64_t index_offset; /* Offset (from the beginning of the file) of the index, n_comb uint64_t values */
+    uint64_t payload_offset; /* Offset of the payload, xpoints doubles (SI units) per combination */
+    uint64_t payload_size; /* Bytes */
+    uint64_t reserved[3];
+} gsto_container_header; /* Index has one offset (from the beginning of the file) per combination, in the order of jibal_gsto_file_get_data_index(). Zero if combination is not in the file. */
+
 typedef enum {
     GSTO_XSCALE_NONE=0,
     GSTO_XSCALE_LINEAR=1,
@@ -153,6 +173,119 @@ static const jibal_option gsto_headers[] = {
         {NULL, 0}
 };
 
+#define GSTO_INDEX_SUFFIX ".idx" /* Index of an ASCII file "foo" is "foo.idx" */
+#define GSTO_INDEX_MAGIC "GSTOIDX"
+#define GSTO_INDEX_VERSION 1
+#define GSTO_INDEX_BUFFER_SIZE (1 << 16)
+#define GSTO_LOAD_TASK_POINTS (1 << 17) /* Parallel loading (jibal_gsto_load_all()) splits files into tasks of approximately this many data points */
+#define GSTO_RESAMPLE_ERROR_FLOOR 1.0e-3 /* Error of resampled data is relative to |y|, but at least this times the largest |y| of the combination */
+#define GSTO_ARENA_ALIGN 64 /* Data of each combination starts at a multiple of this (bytes) in the arena of the file */
+#define GSTO_ARENA_BLOCK_MIN 8 /* First block of an arena holds this many combinations, the following blocks double in size */
+#define GSTO_ARENA_BLOCK_MAX (1 << 20) /* Arena blocks grow up to this size (bytes), unless a single combination needs more */
+#define GSTO_CACHE_TRIM_SLACK 8 /* Automatic trimming (see jibal_gsto_cache_budget()) frees memory down to budget - budget/GSTO_CACHE_TRIM_SLACK */
+
+typedef struct gsto_index_header { /* Index file has this header followed by n_comb pairs of int64_t, offset and line number */
+    char magic[8]; /* GSTO_INDEX_MAGIC, NUL terminated */
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size; /* Size and modification time of the indexed file, index is not used if these change */
+    int64_t file_mtime;
+    int64_t data_offset;
+    uint64_t n_comb;
+    uint64_t xpoints;
+} gsto_index_header;
+
+#define GSTO_IMAGE_ALIGN 64 /* Data in an image (see jibal_gsto_image_write()) starts at a multiple of this (bytes, from the beginning of the image) */
+
+typedef struct gsto_file_record { /* Headers of a file, see jibal_gsto_file_record_write(). Followed by em (xpoints doubles, if has_em), name, filename and source (not NUL terminated) and padding to a multiple of 8 bytes. */
+    uint64_t record_size; /* Including everything that follows */
+    uint64_t file_size; /* Size and modification time of the file, record is not valid if these change */
+    int64_t file_mtime;
+    int32_t Z1_min;
+    int32_t Z1_max;
+    int32_t Z2_min;
+    int32_t Z2_max;
+    int32_t type;
+    int32_t data_format;
+    int32_t xscale;
+    int32_t xunit;
+    int32_t xunit_original;
+    int32_t stounit;
+    int32_t stounit_original;
+    int32_t straggunit;
+    int32_t straggunit_original;
+    int32_t headers_lineno;
+    int32_t data_lineno;
+    int32_t has_em; /* boolean. The x table has been made (data_offset and data_lineno are known and units have been converted) */
+    uint64_t xpoints;
+    double xmin;
+    double xmin_original;
+    double xmax;
+    double xmax_original;
+    int64_t headers_end;
+    int64_t data_offset;
+    uint32_t name_length;
+    uint32_t filename_length;
+    uint32_t source_length; /* Zero if there is no source */
+    uint32_t reserved;
+} gsto_file_record;
+
+typedef struct gsto_image_header { /* GSTO part of an image. Followed by n_files file records (gsto_file_record), n_overrides
+ * overrides (gsto_image_override), 2 * Z1_max * Z2_max file indices (int32_t, stopping and straggling assignments, -1 if
+ * nothing is assigned, padded to a multiple of 8 bytes), n_data data entries (gsto_image_data) and the data itself (at the
+ * next multiple of GSTO_IMAGE_ALIGN). */
+    int32_t Z1_max;
+    int32_t Z2_max;
+    uint64_t n_files;
+    uint64_t n_overrides;
+    uint64_t n_data;
+} gsto_image_header;
+
+typedef struct gsto_image_override {
+    int32_t Z1;
+    int32_t Z2;
+    uint64_t file; /* Index of the file */
+} gsto_image_override;
+
+typedef struct gsto_image_data { /* Data (in SI units, double precision) of one combination */
+    uint64_t file;
+    uint64_t i_comb;
+    uint64_t offset; /* Bytes from the beginning of data, a multiple of GSTO_IMAGE_ALIGN */
+} gsto_image_data;
+
+#define GSTO_MANIFEST_MAGIC "GSTOMAN"
+#define GSTO_MANIFEST_VERSION 2
+#define GSTO_MANIFEST_ENDIAN_CHECK 0x01020304
+
+typedef struct gsto_manifest_header { /* Manifest has this header followed by the name of the settings file (settings_path_length bytes, padded to a multiple of 8), n_files file records (gsto_file_record) and n_rejected rejected records (gsto_manifest_rejected) */
+    char magic[8]; /* GSTO_MANIFEST_MAGIC, NUL terminated */
+    uint32_t version;
+    uint32_t endian_check; /* GSTO_MANIFEST_ENDIAN_CHECK, manifest is not portable */
+    uint64_t settings_size; /* Size and modification time of the settings file (files.txt), manifest is not used if these change */
+    int64_t settings_mtime;
+    uint64_t settings_path_length;
+    uint64_t n_files;
+    uint64_t n_rejected;
+} gsto_manifest_header;
+
+typedef struct gsto_manifest_rejected { /* A file listed in the settings file that could not be added. Followed by the filename (filename_length bytes, padded to a multiple of 8). Manifest is not valid if the file has changed (or appeared). */
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint32_t exists; /* boolean. stat() succeeded, size and modification time are zero otherwise */
+    uint32_t filename_length;
+} gsto_manifest_rejected;
+
+typedef struct gsto_offset {
+    long offset; /* Byte offset of the first line (or byte) of data of a combination */
+    int lineno;
+} gsto_offset;
+
+typedef struct gsto_point { /* Interleaved data point, see jibal_gsto_interleave() */
+    double em;
+    double y; /* Data, always in double precision (divided by the scale, if data is in single precision) */
+    double slope; /* (y[i+1] - y[i]) / (em[i+1] - em[i]), zero for the last point */
+} gsto_point;
+
 typedef struct gsto_file {
     int valid;
     int lineno; /* Keep track of how many lines read */
@@ -184,6 +317,33 @@ typedef struct gsto_file {
     char *source; /* Source of data (meta data from the file) */
     char *filename; /* Filename (relative or full path, whatever fopen can chew) */
     double **data; /* Data is stored here. Array of pointers. Access with functions. */
+    void *map; /* Memory mapped file (format=container), data points here and must not be modified. NULL if not mapped. */
+    size_t map_size;
+    long headers_end; /* Offset after headers */
+    int headers_lineno; /* Line number at headers_end */
+    long data_offset; /* Where data begins (after headers and x table), known after data has been loaded for the first time */
+    int data_lineno; /* Line number at data_offset */
+    gsto_offset *offsets; /* Where data of each combination begins (ASCII), n_comb entries. NULL if not indexed yet. See jibal_gsto_file_index(). */
+    size_t n_indexed; /* Number of entries in offsets that are known (the index is built as far as needed) */
+    void *lock; /* Internal. Loading of data is serialized with this. */
+    double load_time; /* Time spent loading data (s). With parallel loading, time from the start of the first task to the end of the last task of this file. */
+    int resample; /* Points per decade of em, lookups use data resampled to a uniform log(em) grid. 0 if not resampled. See jibal_gsto_resample(). */
+    size_t rs_points; /* Resampled grid spans em[0] ... em[xpoints-1], rs_points points */
+    double *rs_em;
+    double rs_log_em_min; /* log(rs_em[0]) */
+    double rs_div; /* rs_points - 1 divided by log(em) span of the grid */
+    double **rs_data; /* Resampled data of each combination (n_comb). NULL if not resampled. rs_data[i] is NULL if combination i is not resampled (see rs_tolerance), lookups then use the original grid. */
+    double rs_error; /* Largest relative error of resampled data, linearly interpolated, compared to the original data. See GSTO_RESAMPLE_ERROR_FLOOR. */
+    double rs_tolerance; /* Combinations are not resampled if rs_error would exceed this. 0 if there is no limit. See jibal_gsto_resample_tolerance(). */
+    size_t rs_rejected; /* Number of combinations not resampled because of rs_tolerance */
+    int single; /* boolean. Data is stored in single precision, data[i] (and rs_data[i]) points to floats. See jibal_gsto_single_precision(). */
+    double *single_scale; /* Single precision data of combination i is scaled, value is single_scale[i] times the float (n_comb) */
+    double single_error; /* Largest relative error of single precision data compared to double precision data */
+    int interleave; /* boolean. Lookups use interleaved data (il_data). See jibal_gsto_interleave(). */
+    gsto_point **il_data; /* Interleaved data of each combination (n_comb), on the grid lookups use (rs_em if the combination is resampled). NULL if not interleaved. */
+    void *arena; /* Internal. Data, resampled data and interleaved data (except memory mapped data) is allocated from this. */
+    int evictable; /* boolean. Data of each combination is allocated separately instead (not from the arena), so it can be evicted. See jibal_gsto_cache_budget(). */
+    size_t *last_use; /* Trim epoch (see jibal_gsto cache_epoch) of the latest lookup of each combination (n_comb) of an evictable file, least recently used combinations are evicted first */
 } gsto_file_t;
 
 typedef struct gsto_assignment {
@@ -192,6 +352,19 @@ typedef struct gsto_assignment {
     gsto_file_t *file;
 } gsto_assignment;
 
+typedef struct gsto_cache_retired { /* Internal. Data evicted by automatic trimming, freed when no workspace can use it anymore. */
+    void *data;
+    size_t epoch; /* Trim epoch of the eviction */
+} gsto_cache_retired;
+
+typedef struct jibal_gsto_cache_stats { /* See jibal_gsto_cache_get_stats() */
+    size_t budget; /* Bytes, 0 if there is no budget */
+    size_t resident; /* Bytes of data of evictable files in memory */
+    size_t hits; /* Lookups (jibal_gsto_get_loaded_file()) of evictable files through this workspace that found the data in memory */
+    size_t misses; /* Lookups through this workspace that had to load the data */
+    size_t evictions; /* Combinations evicted, automatically or by jibal_gsto_cache_trim() */
+} jibal_gsto_cache_stats;
+
 typedef struct jibal_gsto {
     const jibal_element *elements;
     int Z1_max;
@@ -203,17 +376,57 @@ typedef struct jibal_gsto {
  * be a file assigned. Access with functions. */
     gsto_file_t **stragg_assignments;
     gsto_assignment *overrides;
+    char **rejected; /* Internal. Filenames listed in the settings file that could not be added, recorded in the manifest (see jibal_gsto_manifest_write()) */
+    size_t n_rejected;
+    struct jibal_gsto *parent; /* If this is a view (see jibal_gsto_view_new()), files belong to parent. NULL otherwise. */
+    size_t n_views; /* Number of views of this workspace */
+    struct jibal_gsto **views; /* Internal. Views of this workspace (n_views) */
+    size_t n_views_allocated;
+    void *lock; /* Internal */
     double stop_step; /* as stopping cross section */
+    double stop_tolerance; /* relative tolerance for adaptive step size in layer energy loss calculations, fixed step (stop_step) is used if zero */
     int extrapolate; /* boolean */
+    int write_index; /* boolean. If set, indices of ASCII files are saved next to the files (see jibal_gsto_file_index_write()) */
+    int load_threads; /* Number of threads jibal_gsto_load_all() uses, 1 (or less) loads files one by one in the calling thread. */
+    int lazy; /* boolean. If set, lookups (jibal_gsto_get_em() etc.) assign (jibal_gsto_auto_assign()) and load missing combinations. */
+    size_t cache_budget; /* Bytes of data of evictable files kept in memory, 0 if there is no budget. Views use the budget of the parent. */
+    size_t cache_hits; /* Internal. Lookups through this workspace (each view counts its own), see jibal_gsto_cache_get_stats() */
+    size_t cache_misses;
+    size_t cache_evictions; /* Internal. Of the files of this workspace (not a view) */
+    size_t cache_epoch; /* Internal. Number of trims so far, see gsto_file_t last_use */
+    size_t cache_loaded; /* Internal. Estimate of bytes of data of evictable files in memory, a lookup that loads data starts a trim when this exceeds the budget */
+    gsto_cache_retired *cache_retired; /* Internal. Data evicted by automatic trimming, freed by a later trim */
+    size_t n_cache_retired;
+    size_t n_cache_retired_allocated;
+    size_t cache_pins; /* Internal. See jibal_gsto_cache_pin() */
+    size_t cache_active; /* Internal. Trim epoch when this workspace was pinned, SIZE_MAX if it is not pinned */
 } jibal_gsto;
 
+#define JIBAL_GSTO_CURSOR_WALK 8 /* Cursor walks at most this many bins before falling back to binary search */
+
+typedef struct jibal_gsto_cursor { /* Lookup state of one file, Z1, Z2 combination, see jibal_gsto_cursor_index(). Each thread needs its own cursor. */
+    const gsto_file_t *file; /* NULL if stopping is not available */
+    const double *em; /* Grid (file->em, or file->rs_em if resampled) */
+    size_t xpoints;
+    const double *data; /* Floats if single is set, use jibal_gsto_cursor_data() */
+    int single;
+    const gsto_point *points; /* Interleaved data (same grid as em), NULL if not interleaved. Interpolation uses this instead of data. */
+    double factor; /* Unit conversion for data that hasn't been converted to SI (and scale of single precision data) */
+    size_t lo; /* Bin of previous lookup */
+    int extrapolate;
+} jibal_gsto_cursor;
+
 #include <jibal_masses.h>
 #include <jibal_material.h>
 #include <jibal_layer.h>
 
 jibal_gsto *jibal_gsto_init(const jibal_element *elements, int Z_max, const char *files_file_name,
                             const char *assignments_file_name);
+jibal_gsto *jibal_gsto_init_manifest(const jibal_element *elements, int Z_max, const char *files_file_name,
+                            const char *assignments_file_name, const char *manifest_file_name); /* Like jibal_gsto_init(), but files are added from the manifest if it is valid. Otherwise the manifest is made again. */
 int jibal_gsto_read_settings_file(jibal_gsto *workspace, const char *filename);
+int jibal_gsto_manifest_read(jibal_gsto *workspace, const char *manifest_file_name, const char *files_file_name); /* Adds files listed in the settings file from a manifest made by jibal_gsto_manifest_write(), without opening them (files are stat()ed). Returns the number of files added, 0 if the manifest doesn't exist or it is not valid (then no files are added). */
+int jibal_gsto_manifest_write(const jibal_gsto *workspace, const char *manifest_file_name, const char *files_file_name); /* Writes headers of all files of workspace, which should have been added from files_file_name, and the files that could not be added. Returns 1 on success. Failure (e.g. directory is not writable) is not an error. */
 gsto_assignment *jibal_gsto_read_assignments_file(jibal_gsto *workspace, const char *filename);
 int jibal_gsto_add_file(jibal_gsto *workspace, jibal_element *elements, const char *name, const char *filename);
 int jibal_gsto_file_has_combination(const gsto_file_t *file, int Z1, int Z2);
@@ -231,8 +444,46 @@ const char *jibal_gsto_file_source(const gsto_file_t *file);
 void jibal_gsto_file_free(gsto_file_t *file);
 void jibal_gsto_free(jibal_gsto *workspace);
 
+/* Threads and views.
+ *
+ * Stopping files and their data (workspace->files) can be shared by several threads using views. Each view has its own
+ * assignments, overrides and settings (stop_step, extrapolate...), but the files (the stopping database) belong to
+ * the workspace given by jibal_gsto_init() (the parent). A view starts with a copy of the assignments of the workspace
+ * it was made of.
+ *
+ * Guarantees:
+ *  - Each jibal_gsto (parent or view) must be used by only one thread at a time, since assignments are not protected.
+ *    Use one view per thread.
+ *  - jibal_gsto_load() and jibal_gsto_load_all() can be called from any view at any time. Loading of one file is
+ *    serialized by a lock in the file. Only combinations that are not loaded yet are loaded, so it is safe to look up
+ *    (e.g. jibal_gsto_get_em(), jibal_stop()) already loaded combinations while other threads load new ones.
+ *  - Files (jibal_gsto_get_loaded_file() etc) stay valid until jibal_gsto_free() of the parent. Data of a file
+ *    (jibal_gsto_file_get_data(), jibal_gsto_file_get_raw_data(), the grid file->em and cursors made of them) stays
+ *    valid until jibal_gsto_free() of the parent too, with these exceptions:
+ *    - jibal_gsto_resample(), jibal_gsto_resample_tolerance() and jibal_gsto_interleave() make resampled and
+ *      interleaved data (and the resampled grid) again. Cursors and stopping kernels made before must be made again.
+ *    - jibal_gsto_file_allocate_data() replaces data of a combination.
+ *    - Data of evictable files (see jibal_gsto_cache_budget()) can be evicted whenever data is loaded. It is freed when
+ *      no pinned workspace (see jibal_gsto_cache_pin()) can use it, so pin the workspace for as long as you use data
+ *      or cursors obtained through it. Lookups pin for the duration of the call and stopping kernels for their
+ *      lifetime. jibal_gsto_cache_trim() frees evicted data immediately, pinned or not.
+ *    The functions above must not be called while other threads use the files, except that automatic eviction is safe.
+ *  - Files can not be added after views have been made, and the parent must be freed last.
+ *  - Header-only loading (jibal_gsto_load() with headers_only == TRUE) is not thread safe.
+ * */
+jibal_gsto *jibal_gsto_view_new(const jibal_gsto *workspace); /* New view of workspace (or of the parent of workspace, if it is a view). Free with jibal_gsto_free(). */
+
 int jibal_gsto_load(jibal_gsto *workspace, int headers_only, gsto_file_t *file);
-int jibal_gsto_load_all(jibal_gsto *workspace);
+int jibal_gsto_load_all(jibal_gsto *workspace); /* Loads assigned combinations of all files. If workspace->load_threads > 1, files are loaded in parallel, large files are split to Z1 ranges. Returns the number of files loaded successfully. */
+int jibal_gsto_resample_tolerance(jibal_gsto *workspace, double tolerance); /* Combinations are resampled (see jibal_gsto_resample()) only if the largest relative error of resampled data is at most tolerance, otherwise lookups use the original data. 0 (the default) disables the check. Must not be called while other threads use the files. Returns the number of combinations that are not resampled. */
+int jibal_gsto_resample(jibal_gsto *workspace, int points_per_decade); /* Lookups (jibal_gsto_get_em(), cursors etc) use data resampled to a uniform log(em) grid, both loaded data and data loaded later. 0 restores original data. Must not be called while other threads use the files. Returns the number of files with resampled data. */
+int jibal_gsto_single_precision(jibal_gsto *workspace); /* Data of files that are not loaded yet will be stored in single precision (float), interpolation is still done in double precision. Memory mapped containers remain double. Returns the number of files affected. */
+int jibal_gsto_cache_budget(jibal_gsto *workspace, size_t bytes); /* Data of files that are not loaded yet becomes evictable. Lookups (jibal_gsto_get_loaded_file()) load evicted combinations again, also without lazy loading. When loading makes the data exceed bytes, least recently used combinations are evicted automatically, but not those looked up since the previous trim. Evicted data is freed later, when no pinned workspace (see jibal_gsto_cache_pin()) can use it. Memory mapped data is never evicted. Returns the number of evictable files. */
+size_t jibal_gsto_cache_trim(jibal_gsto *workspace); /* Evicts least recently used combinations of evictable files until the budget is met and frees them immediately. Data obtained before (cursors, stopping kernels) may become invalid. Must not be called while other threads use the workspace or its views. Returns the number of bytes freed. */
+jibal_gsto_cache_stats jibal_gsto_cache_get_stats(const jibal_gsto *workspace);
+void jibal_gsto_cache_pin(const jibal_gsto *workspace); /* Data of evictable files obtained through workspace (directly, or with cursors) is not freed by automatic trimming until jibal_gsto_cache_unpin(). Calls nest. Lookups and stopping kernels (jibal_stop_kernel_new()) pin the workspace themselves. */
+void jibal_gsto_cache_unpin(const jibal_gsto *workspace);
+int jibal_gsto_interleave(jibal_gsto *workspace, int interleave); /* Lookups use data interleaved as (em, y, slope) points (see gsto_point), both loaded data and data loaded later. Interpolation then needs one cache line and no division. FALSE restores separate arrays. Must not be called while other threads use the files. Returns the number of files with interleaved data. */
 
 
 
@@ -241,12 +492,25 @@ int jibal_gsto_load_all(jibal_gsto *workspace);
 jibal_gsto *jibal_gsto_allocate(int Z1_max, int Z2_max);
 int jibal_gsto_load_ascii_file(jibal_gsto *workspace, gsto_file_t *file);
 int jibal_gsto_load_binary_file(jibal_gsto *workspace, gsto_file_t *file);
+int jibal_gsto_load_container_file(jibal_gsto *workspace, gsto_file_t *file);
+int jibal_gsto_load_combination(const jibal_gsto *workspace, gsto_file_t *file, int Z1, int Z2); /* Loads one combination (if it isn't loaded yet) using an index. Thread safe. */
+int jibal_gsto_file_index(gsto_file_t *file, size_t n); /* Scans the data until offsets of the first n combinations (n_comb for all) are known. Continues from where the previous call stopped. Caller must hold file->lock and have file->fp open. */
+int jibal_gsto_file_index_read(gsto_file_t *file); /* Reads file->offsets from the index file, if it is valid (file has not changed). Requires data_offset. */
+int jibal_gsto_file_index_write(const gsto_file_t *file); /* Writes file->offsets to the index file (filename + GSTO_INDEX_SUFFIX) */
 void jibal_gsto_fprint_file(FILE *file_out, const jibal_gsto *workspace, const gsto_file_t *file, gsto_data_format format, int Z1_min, int Z1_max, int Z2_min, int Z2_max);
+int jibal_gsto_file_record_write(FILE *f, const gsto_file_t *file, int with_em); /* Writes headers of the file (and the x table, if with_em is set and it has been made) as a gsto_file_record. Returns 1 on success. */
+size_t jibal_gsto_file_record_read(gsto_file_t *file, const char *record, size_t size); /* Restores headers of a file (not loaded) from a record made by jibal_gsto_file_record_write(). At most size bytes are read. Returns the size of the record, 0 if it is not valid or the file has changed. */
+int jibal_gsto_image_write(FILE *f, const jibal_gsto *workspace, int with_data); /* Writes files, assignments and overrides (gsto_image_header), and loaded data if with_data is set. File position must be a multiple of 8 from the beginning of the image. Must not be called while other threads load data. Returns 1 on success. */
+jibal_gsto *jibal_gsto_image_read(const jibal_element *elements, const char *image, size_t image_size, size_t offset); /* Workspace from an image (written by jibal_gsto_image_write() at offset). Data is used where it is, so image must stay in memory (and unmodified) until the workspace is freed. NULL if image is not valid or files have changed. */
 
 size_t jibal_gsto_file_get_data_index(const gsto_file_t *file, int Z1, int Z2);
 void jibal_gsto_file_calculate_ncombs(gsto_file_t *file);
-double *jibal_gsto_file_allocate_data(gsto_file_t *file, int Z1, int Z2);
+const double *jibal_gsto_file_get_data(const gsto_file_t *file, int Z1, int Z2); /* NULL if not loaded or if file->single is set (use jibal_gsto_file_get_data_point() or jibal_gsto_file_get_raw_data() then) */
+const void *jibal_gsto_file_get_raw_data(const gsto_file_t *file, int Z1, int Z2); /* Data as stored: doubles, or floats to be multiplied by file->single_scale if file->single is set. NULL if not loaded. */
+double jibal_gsto_file_get_data_point(const gsto_file_t *file, int Z1, int Z2, size_t i); /* Point i (of file->xpoints) of data in double precision, also if file->single is set. 0.0 if not loaded. */
+double *jibal_gsto_file_allocate_data(gsto_file_t *file, int Z1, int Z2); /* Zeroed data (in double precision) for Z1, Z2, replaces previous data. NULL if the file is in single precision or mapped (data can not be written then) or if out of memory. Callers must check. */
 gsto_file_t *jibal_gsto_get_assigned_file(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2);
+const gsto_file_t *jibal_gsto_get_loaded_file(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2); /* Assigned file, if data for Z1, Z2 is loaded. In lazy mode assigns and loads as necessary (assignments of workspace are modified). NULL on failure. */
 gsto_file_t *jibal_gsto_get_file(const jibal_gsto *workspace, const char *name);
 double jibal_gsto_em_from_file_units(double x, const gsto_file_t *file);
 double *jibal_gsto_em_table(const gsto_file_t *file);
@@ -254,6 +518,11 @@ int jibal_gsto_velocity_to_index(const gsto_file_t *file, double v);
 void jibal_gsto_calculate_speedups(gsto_file_t *file);
 void jibal_gsto_convert_file_to_SI(gsto_file_t *file);
 double jibal_gsto_get_em(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, double em);
+int jibal_gsto_get_em_many(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2, const double *em, double *out, size_t n); /* Same as jibal_gsto_get_em() for n points, out[i] for em[i]. Returns 0 if stopping isn't assigned or loaded. */
+int jibal_gsto_get_em_many_Z2(const jibal_gsto *workspace, gsto_stopping_type type, int Z1, const int *Z2, const double *em, double *out, size_t n); /* Z2[i] for each point. Sort by Z2 for best performance. */
+int jibal_gsto_cursor_init(jibal_gsto_cursor *cursor, const jibal_gsto *workspace, gsto_stopping_type type, int Z1, int Z2); /* Returns 0 if stopping isn't assigned or loaded, lookups with the cursor then return zero. With a cache budget, pin the workspace (jibal_gsto_cache_pin()) for as long as the cursor is used. */
+int jibal_gsto_cursor_index(jibal_gsto_cursor *cursor, double em); /* Same as jibal_gsto_em_to_index(), but the search starts from the bin of the previous lookup. Amortized O(1) when em changes slowly, as in energy loss integration. */
+double jibal_gsto_cursor_get_em(jibal_gsto_cursor *cursor, double em); /* Same as jibal_gsto_get_em() */
 
 void jibal_gsto_fprint_header_property(FILE *f, gsto_header_type h, int val);
 void jibal_gsto_fprint_header_int(FILE *f, gsto_header_type h, int i);
@@ -263,8 +532,11 @@ void jibal_gsto_fprint_header(FILE *f, gsto_header_type h, const void *val);
 inline size_t jibal_gsto_table_get_index(const jibal_gsto *workspace, int Z1, int Z2) {
     return (workspace->Z2_max * (Z1 - 1) + (Z2 - 1));
 }
-inline const double *jibal_gsto_file_get_data(const gsto_file_t *file, int Z1, int Z2) {
-    return file->data[jibal_gsto_file_get_data_index(file, Z1, Z2)];
+inline double jibal_gsto_cursor_data(const jibal_gsto_cursor *cursor, size_t i) { /* Data point i, cursor->factor not included */
+    if(cursor->points) {
+        return cursor->points[i].y;
+    }
+    return cursor->single ? ((const float *)cursor->data)[i] : cursor->data[i];
 }
 int jibal_gsto_em_to_index(const gsto_file_t *file, double em);
 double jibal_gsto_xunit_to_energy(gsto_xunit xunit, double value, double mass); /* Convert value in xunit to energy (J) if mass is mass (in kg) */
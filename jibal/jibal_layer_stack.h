@@ -0,0 +1,49 @@
+/*
+    JIBAL - Library for ion beam analysis
+    Copyright (C) 2020 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Stack of layers traversed by an ion. Energy and accumulated straggling at each layer boundary are cached, so that when
+ * one layer changes (e.g. during fitting) only that layer and the ones below it are recalculated. */
+
+#ifndef _JIBAL_LAYER_STACK_H_
+#define _JIBAL_LAYER_STACK_H_
+
+#include <jibal_masses.h>
+#include <jibal_layer.h>
+#include <jibal_gsto.h>
+
+typedef struct jibal_layer_stack {
+    jibal_gsto *workspace;
+    const jibal_isotope *incident;
+    double factor; /* Passed on to jibal_layer_energy_loss_with_straggling(), -1.0 when going in */
+    size_t n_layers;
+    jibal_layer **layers; /* Not owned by the stack */
+    double *E; /* E[i] is the energy when entering layer i, E[n_layers] is the energy after the last layer. Size n_layers+1. */
+    double *S; /* Accumulated straggling at the same boundaries as E */
+    size_t n_valid; /* Internal. E[0...n_valid-1] and S[0...n_valid-1] are up to date. */
+    size_t n_calculated; /* Number of layers calculated so far (statistics) */
+} jibal_layer_stack;
+
+jibal_layer_stack *jibal_layer_stack_new(jibal_gsto *workspace, const jibal_isotope *incident, jibal_layer **layers, size_t n_layers, double E_0, double factor); /* Layers (array and the layers) must outlive the stack. Stopping must be assigned. Returns NULL on error. */
+void jibal_layer_stack_free(jibal_layer_stack *stack);
+void jibal_layer_stack_set_energy(jibal_layer_stack *stack, double E_0); /* Sets incident energy, invalidates all layers */
+void jibal_layer_stack_invalidate(jibal_layer_stack *stack, size_t i_layer); /* Call this after changing layer i_layer (thickness, material) */
+void jibal_layer_stack_set_thickness(jibal_layer_stack *stack, size_t i_layer, double thickness); /* Changes thickness and invalidates the layer (if thickness changed) */
+double jibal_layer_stack_energy(jibal_layer_stack *stack, size_t i_boundary, double *S); /* Energy entering layer i_boundary (n_layers gives energy after the last layer). Accumulated straggling is stored in S unless it is NULL. Out of date layers above the boundary are recalculated. */
+double jibal_layer_stack_exit_energy(jibal_layer_stack *stack, double *S); /* Same as jibal_layer_stack_energy() for boundary n_layers */
+
+#endif /* _JIBAL_LAYER_STACK_H_ */
@@ -19,6 +19,7 @@
 #ifndef _JIBAL_MASSES_H_
 #define _JIBAL_MASSES_H_
 
+#include <stdint.h>
 #include <jibal_units.h>
 #include <jibal_phys.h>
 
@@ -36,6 +37,10 @@
 
 #define JIBAL_ISOTOPE_NAME_LENGTH 8
 
+#define JIBAL_MASSES_CACHE_MAGIC "JIBALIS" /* Binary image of isotopes, see jibal_isotopes_cache_read() */
+#define JIBAL_MASSES_CACHE_VERSION 1
+#define JIBAL_MASSES_CACHE_ENDIAN_CHECK 0x01020304
+
 typedef char isotope_name[JIBAL_ISOTOPE_NAME_LENGTH]; /* These should be null terminated */
 typedef char element_name[JIBAL_ISOTOPE_NAME_LENGTH];
 
@@ -47,8 +52,33 @@ typedef struct jibal_isotope {
     double mass;
     double abundance; /* Do not change this. It is not a concentration. */
     size_t i; /* This isotope is the ith isotope in jibal->isotopes (calculated when loading), numbering starts from zero */
+    const void *index; /* Internal. Lookup tables of the whole table (same for every isotope), see jibal_isotope_find(). NULL if not indexed. */
 } jibal_isotope; /* All jibal_isotopes are supposed to be static data */
 
+typedef struct jibal_masses_cache_header { /* Cache file has this header followed by n_isotopes records (jibal_masses_cache_record) */
+    char magic[8]; /* JIBAL_MASSES_CACHE_MAGIC, NUL terminated */
+    uint32_t version;
+    uint32_t endian_check; /* JIBAL_MASSES_CACHE_ENDIAN_CHECK, cache is not portable */
+    uint64_t masses_size; /* Size, modification time and hash (FNV-1a) of the masses file, cache is not used if these change */
+    int64_t masses_mtime;
+    uint64_t masses_hash;
+    uint64_t abundances_size; /* Same for the abundances file */
+    int64_t abundances_mtime;
+    uint64_t abundances_hash;
+    uint64_t n_isotopes;
+    uint64_t record_size; /* sizeof(jibal_masses_cache_record) */
+} jibal_masses_cache_header;
+
+typedef struct jibal_masses_cache_record {
+    isotope_name name;
+    int32_t N;
+    int32_t Z;
+    int32_t A;
+    int32_t reserved;
+    double mass;
+    double abundance;
+} jibal_masses_cache_record;
+
 typedef struct {
     element_name name; /* by default something like "Si", but "natSi", "28Si" are valid names too after jibal_element_copy() */
     int Z;
@@ -56,13 +86,18 @@ typedef struct {
     const jibal_isotope **isotopes; /* Array of length n_isotopes, contents are pointers to isotopes */
     double *concs; /* This is NULL in "elements" table, but when used by jibal_material the concentrations of isotopes goes in an array here. */
     double avg_mass; /* Average mass */
+    const void *index; /* Internal. Lookup tables of the "elements" table (same for every element), see jibal_element_find(). NULL in copies. */
 } jibal_element;
 
-jibal_isotope *jibal_isotopes_load(const char *filename);
+jibal_isotope *jibal_isotopes_load(const char *filename); /* Loads isotopes and indexes them by name and by Z and A */
 size_t jibal_isotopes_n(const jibal_isotope *isotopes); /* Number of isotopes */
 int jibal_abundances_load(jibal_isotope *isotopes, const char *filename);
+jibal_isotope *jibal_isotopes_cache_read(const char *filename, const char *masses_file, const char *abundances_file); /* Isotopes (with abundances) from a binary image made by jibal_isotopes_cache_write(). NULL if the cache doesn't exist or it was not made from these masses and abundances files (as they are now). */
+int jibal_isotopes_cache_write(const jibal_isotope *isotopes, const char *filename, const char *masses_file, const char *abundances_file); /* Returns 1 on success. Failure (e.g. directory is not writable) is not an error. */
+jibal_isotope *jibal_isotopes_from_records(const jibal_masses_cache_record *records, size_t n); /* Isotope table (indexed) from n records. NULL if the records are not valid. */
+jibal_masses_cache_record *jibal_isotopes_to_records(const jibal_isotope *isotopes, size_t *n); /* Records of all isotopes, number of records is stored in n. Caller must free. */
 void jibal_isotopes_free(jibal_isotope *isotopes);
-jibal_element *jibal_elements_populate(const jibal_isotope *isotopes);
+jibal_element *jibal_elements_populate(const jibal_isotope *isotopes); /* Makes the "elements" table (indexed by Z, name lookups use a hash table) */
 int jibal_elements_Zmax(const jibal_element *elements);
 void jibal_element_free(jibal_element *element);
 void jibal_elements_free(jibal_element *elements); /* Used to free array created by jibal_elements_populate() */
@@ -0,0 +1,67 @@
+/*
+    Jyväskylä Ion Beam Analysis Library (JIBAL)
+    Copyright (C) 2020 - 2026 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Range (path length vs. energy) tables. Energy loss in a layer becomes a table lookup instead of integration.
+ *
+ * The path length X(E) is the integral of 1/S from E_min to E, where S is the stopping of a jibal_stop_table. Stopping
+ * is linear between table points, so X and its inverse are calculated exactly (w.r.t. the table) within each bin.
+ * X is in units of areal density (1/m^2), i.e. the same units as layer thickness. */
+
+#ifndef JIBAL_RANGE_H
+#define JIBAL_RANGE_H
+
+#include <jibal_masses.h>
+#include <jibal_material.h>
+#include <jibal_layer.h>
+#include <jibal_gsto.h>
+#include <jibal_stop_table.h>
+
+#define JIBAL_RANGE_CACHE_SIZE_INITIAL 8
+
+typedef struct jibal_range {
+    jibal_stop_table *table;
+    jibal_material *material; /* Our own copy, used as a key by jibal_range_cache */
+    double *X; /* Path length from E_min to E[i] (1/m^2), size n */
+    double *W; /* Cumulative straggling weight, integral of stragg/S^3 dE from E_min to E[i], size n. NULL if table has no straggling. */
+} jibal_range;
+
+typedef struct jibal_range_cache {
+    jibal_gsto *workspace;
+    jibal_range **ranges;
+    size_t n_ranges;
+    size_t n_ranges_allocated;
+    size_t hits;
+    size_t misses;
+} jibal_range_cache;
+
+jibal_range *jibal_range_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, size_t n); /* Stopping must be assigned and loaded. n is passed to jibal_stop_table_new(). */
+void jibal_range_free(jibal_range *range);
+double jibal_range_path(const jibal_range *range, double E); /* X(E). Below the table range (with extrapolation) this is negative. Returns NAN if E is out of range. */
+double jibal_range_energy(const jibal_range *range, double X); /* Inverse of jibal_range_path(), O(log n). Returns 0.0 if X is out of range. */
+double jibal_range_energy_loss(const jibal_range *range, double thickness, double E_0, double factor); /* Same as jibal_layer_energy_loss() */
+double jibal_range_energy_loss_with_straggling(const jibal_range *range, double thickness, double E_0, double factor, double *S); /* Same as jibal_layer_energy_loss_with_straggling() */
+double jibal_range_thickness(const jibal_range *range, double E_0, double E, double factor); /* Thickness required to go from E_0 to E. Returns NAN if this is not possible. */
+
+jibal_range_cache *jibal_range_cache_new(jibal_gsto *workspace);
+void jibal_range_cache_free(jibal_range_cache *cache);
+void jibal_range_cache_clear(jibal_range_cache *cache); /* Call this if stopping assignments or data change */
+const jibal_range *jibal_range_cache_get(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_material *target); /* Range of incident in target, made on first call. Materials are compared by content, including isotopic composition. */
+double jibal_range_cache_layer_energy_loss(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor); /* Same as jibal_layer_energy_loss() */
+double jibal_range_cache_layer_energy_loss_with_straggling(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor, double *S); /* Same as jibal_layer_energy_loss_with_straggling() */
+
+#endif /* JIBAL_RANGE_H */
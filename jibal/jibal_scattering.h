@@ -0,0 +1,54 @@
+/*
+    JIBAL - Library for ion beam analysis
+    Copyright (C) 2020 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _JIBAL_SCATTERING_H_
+#define _JIBAL_SCATTERING_H_
+
+#include <jibal_material.h>
+#include <jibal_cross_section.h>
+
+/* Scattering of an incident ion from all isotopes of a material to a fixed angle. Everything that does not depend on
+ * energy is computed once, per isotope values are stored in arrays (of length n_isotopes) */
+
+typedef struct jibal_scattering {
+    const jibal_isotope *incident;
+    double theta; /* Scattering angle (RBS) and recoil angle (ERD), lab */
+    jibal_cross_section_type cs_rbs;
+    jibal_cross_section_type cs_erd;
+    int erd; /* Recoils can reach theta, i.e. theta is below 90 deg */
+    size_t n_isotopes;
+    const jibal_isotope **isotopes;
+    double *conc; /* Concentration of isotope in material (element concentration times isotope concentration) */
+    double *theta_max; /* Maximum scattering angle, C_PI if incident is lighter than the isotope */
+    double *K_plus; /* RBS kinematic factor (plus-sign solution), zero if scattering to theta is not possible */
+    double *K_minus; /* RBS kinematic factor (minus-sign solution), zero unless incident is heavier than the isotope and scattering is possible */
+    double *K_erd; /* ERD kinematic factor, zero if recoils can not reach theta */
+    double *rbs_sigma_factor; /* Cross section factors, see jibal_cross_section. Concentration is included, zero if scattering is not possible */
+    double *rbs_andersen_a;
+    double *rbs_andersen_b;
+    double *erd_sigma_factor;
+    double *erd_andersen_a;
+    double *erd_andersen_b;
+} jibal_scattering;
+
+jibal_scattering *jibal_scattering_new(const jibal_isotope *incident, const jibal_material *material, double theta, jibal_cross_section_type cs_rbs, jibal_cross_section_type cs_erd); /* Material is not referenced afterwards. Returns NULL on error. */
+void jibal_scattering_free(jibal_scattering *scattering);
+double jibal_scattering_rbs(const jibal_scattering *scattering, double E, double *sigma); /* Concentration weighted RBS cross sections of all isotopes at energy E are stored to sigma (can be NULL). Returns their sum. */
+double jibal_scattering_erd(const jibal_scattering *scattering, double E, double *sigma); /* Same as jibal_scattering_rbs(), but for ERD */
+
+#endif /* _JIBAL_SCATTERING_H_ */
@@ -3,10 +3,73 @@
 
 #include <jibal_gsto.h>
 
+#define JIBAL_STOP_ADAPTIVE_ATOL (1.0*C_KEV) /* Absolute tolerance of adaptive energy loss is rtol times this */
+#define JIBAL_STOP_ADAPTIVE_MAX_STEPS 1000000
+
+/* Universal nuclear stopping S_n(epsilon) is tabulated from epsilon = 2^(EXP_MIN-1) to 2^(EXP_MAX-1) with BINS bins per
+ * octave. The table is linear in epsilon*S_n(epsilon) within each bin, relative error compared to
+ * jibal_stop_nuc_reduced() is less than JIBAL_STOP_NUC_TABLE_RTOL. Outside the table S_n is calculated. */
+#define JIBAL_STOP_NUC_TABLE_EXP_MIN (-20)
+#define JIBAL_STOP_NUC_TABLE_EXP_MAX 31
+#define JIBAL_STOP_NUC_TABLE_BINS 64
+#define JIBAL_STOP_NUC_TABLE_RTOL 5.0e-5
+#ifdef NUCLEAR_STOPPING_ISOTOPES
+#define JIBAL_STOP_NUC_ISOTOPES TRUE
+#else
+#define JIBAL_STOP_NUC_ISOTOPES FALSE
+#endif
+
+typedef struct jibal_stop_nuc_pair { /* Nuclear stopping of incident ion in one target element (or isotope) */
+    double eps_per_E; /* Reduced energy is epsilon = eps_per_E*E */
+    double S_factor; /* Stopping (weighted with concentration) is S_factor*S_n(epsilon) */
+} jibal_stop_nuc_pair;
+
+typedef struct jibal_stop_nuc_ctx { /* Precomputed nuclear stopping of an ion in a material */
+    jibal_stop_nuc_pair *pairs;
+    size_t n_pairs;
+    const double *table; /* Shared table of S_n, see JIBAL_STOP_NUC_TABLE_BINS */
+} jibal_stop_nuc_ctx;
+
+typedef struct jibal_stop_kernel_element { /* Electronic stopping and straggling data of one element, see jibal_stop_kernel */
+    double conc;
+    int Z2;
+    jibal_gsto_cursor sto; /* sto.file is NULL if not available (lazy mode) */
+    jibal_gsto_cursor stragg; /* stragg.file is NULL if not available */
+    int shared_grid; /* TRUE if stopping and straggling have the same x table, index is calculated only once */
+} jibal_stop_kernel_element;
+
+typedef struct jibal_stop_kernel { /* Total stopping, its derivative and straggling of an ion in a material, evaluated together. Lookups use cursors, so a kernel must be used by one thread at a time. */
+    const jibal_gsto *workspace; /* Pinned (see jibal_gsto_cache_pin()) while the kernel exists */
+    const jibal_isotope *incident;
+    size_t n_elements;
+    jibal_stop_kernel_element *elements;
+    jibal_stop_nuc_ctx *nuc;
+} jibal_stop_kernel;
+
+typedef struct jibal_stop_kernel_result {
+    double S; /* Total stopping (same as jibal_stop()) */
+    double dSdE; /* dS/dE */
+    double stragg; /* Straggling (same as jibal_stragg()) */
+    double dstraggdE; /* d(stragg)/dE */
+} jibal_stop_kernel_result;
+
 double jibal_stop(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, double E);
 double jibal_stop_ele(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, double E);
-double jibal_stop_nuc(const jibal_isotope *incident, const jibal_material *target, double E); /* TODO: energy range */
-double jibal_layer_energy_loss(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_layer *layer, double E, double factor);
+double jibal_stop_nuc(const jibal_isotope *incident, const jibal_material *target, double E); /* TODO: energy range. Isotope resolved if NUCLEAR_STOPPING_ISOTOPES is defined. */
+jibal_stop_nuc_ctx *jibal_stop_nuc_ctx_new(const jibal_isotope *incident, const jibal_material *target, int isotopes); /* If isotopes is TRUE, stopping is calculated for each isotope separately, otherwise with average mass of element. Pass JIBAL_STOP_NUC_ISOTOPES to get the same as jibal_stop_nuc(). */
+void jibal_stop_nuc_ctx_free(jibal_stop_nuc_ctx *ctx);
+double jibal_stop_nuc_ctx_get(const jibal_stop_nuc_ctx *ctx, double E); /* Nuclear stopping, same as jibal_stop_nuc() but no pow() calls */
+double jibal_stop_with_ctx(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, const jibal_stop_nuc_ctx *nuc, double E); /* Same as jibal_stop(), nuc must be made for the same incident and target */
+double jibal_stop_nuc_reduced(double epsilon); /* Universal reduced nuclear stopping S_n(epsilon) */
+double jibal_stop_nuc_ctx_get_deriv(const jibal_stop_nuc_ctx *ctx, double E, double *dSdE); /* Nuclear stopping and its derivative (dSdE) */
+double jibal_stop_nuc_reduced_fast(double epsilon); /* Tabulated S_n(epsilon), see JIBAL_STOP_NUC_TABLE_RTOL */
+jibal_stop_kernel *jibal_stop_kernel_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target); /* Data is looked up (and loaded in lazy mode) once. Kernel must not outlive workspace. */
+void jibal_stop_kernel_free(jibal_stop_kernel *kernel);
+double jibal_stop_kernel_stop(jibal_stop_kernel *kernel, double E); /* Total stopping, same as jibal_stop() */
+double jibal_stop_kernel_stragg(jibal_stop_kernel *kernel, double E); /* Straggling, same as jibal_stragg() */
+void jibal_stop_kernel_eval(jibal_stop_kernel *kernel, double E, jibal_stop_kernel_result *result); /* Stopping, straggling and their derivatives with one index computation per element */
+double jibal_layer_energy_loss(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_layer *layer, double E, double factor); /* Uses adaptive step if workspace->stop_tolerance > 0 */
+double jibal_layer_energy_loss_adaptive(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor, double rtol, double *S, size_t *n_steps); /* S (straggling) may be NULL. Number of accepted steps is stored in n_steps, unless it is NULL. */
 
 double jibal_gsto_stop_v(jibal_gsto *workspace, int Z1, int Z2, double v); /* Kinda deprecated */
 double jibal_gsto_stop_em(jibal_gsto *workspace, int Z1, int Z2, double em); /* Kinda deprecated */
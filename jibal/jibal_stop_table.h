@@ -0,0 +1,58 @@
+/*
+    Jyväskylä Ion Beam Analysis Library (JIBAL)
+    Copyright (C) 2020 - 2026 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compiled (precalculated) stopping of one incident ion in one material */
+
+#ifndef JIBAL_STOP_TABLE_H
+#define JIBAL_STOP_TABLE_H
+
+#include <jibal_masses.h>
+#include <jibal_material.h>
+#include <jibal_gsto.h>
+#include <jibal_stop.h>
+
+#ifndef JIBAL_STOP_TABLE_XPOINTS
+#define JIBAL_STOP_TABLE_XPOINTS 2001 /* Default number of points, used when stopping files don't share a common grid */
+#endif
+#define JIBAL_STOP_TABLE_OVERSAMPLING 4 /* Points per bin of the stopping file, when files share a common log grid */
+
+typedef struct jibal_stop_table {
+    const jibal_isotope *incident;
+    size_t n; /* Number of points in the table */
+    double E_min; /* Energy of the first point (J) */
+    double E_max; /* Energy of the last point (J) */
+    double log_E_min; /* speedup, log10(E_min) */
+    double div; /* speedup, (n - 1)/(log10(E_max) - log10(E_min)) */
+    double *E; /* Energy (J), log10 spaced, size n */
+    double *S; /* Total stopping cross section (electronic + nuclear, concentration weighted) J m^2, size n */
+    double *stragg; /* Straggling (concentration weighted) J^2 m^2, size n. NULL if straggling is not assigned or loaded. */
+    double S_ele_min; /* Electronic stopping at E_min and E_max, stopping outside the table is extrapolated from these */
+    double S_ele_max;
+    jibal_stop_nuc_ctx *nuc; /* Nuclear stopping outside the table */
+    double stop_step; /* Step for layer energy loss calculations, copied from GSTO workspace */
+    int extrapolate; /* boolean, copied from GSTO workspace */
+} jibal_stop_table;
+
+jibal_stop_table *jibal_stop_table_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, size_t n); /* Stopping must be assigned and loaded. If n == 0 the number of points is chosen automatically. */
+void jibal_stop_table_free(jibal_stop_table *table);
+int jibal_stop_table_index(const jibal_stop_table *table, double E); /* Returns i, where E[i] <= E < E[i+1], or -1 if E is out of range */
+double jibal_stop_table_get(const jibal_stop_table *table, double E); /* Same as jibal_stop(), but from the table */
+double jibal_stop_table_get_stragg(const jibal_stop_table *table, double E); /* Same as jibal_stragg(), but from the table. Returns 0.0 if table has no straggling. */
+double jibal_stop_table_layer_energy_loss(const jibal_stop_table *table, double thickness, double E_0, double factor); /* Same as jibal_layer_energy_loss() */
+
+#endif /* JIBAL_STOP_TABLE_H */
@@ -122,10 +122,12 @@ typedef struct jibal_units {
     jibal_unit_type type;
     char *name; /*!< E.g. "u" */
     struct jibal_units *next; /*!< Linked list */
+    void *table; /*!< Internal. Compiled lookup table (see jibal_units_compile()), only in the first unit of the list. NULL if not compiled. */
 } jibal_units;
 
 jibal_units *jibal_units_add(jibal_units *units, double f, char type, char *name);
-jibal_units *jibal_units_default(void);
+jibal_units *jibal_units_default(void); /* Default units, compiled */
+int jibal_units_compile(jibal_units *units); /* Makes a hash table of all units and their SI prefixed variants (for each unit type), used by jibal_units_get(). Units added later with jibal_units_add() are compiled automatically. Returns the number of entries. */
 int jibal_units_count(const jibal_units *units);
 int jibal_units_print(FILE *out, const jibal_units *units);
 jibal_unit_type jibal_unit_type_get(const jibal_units *units, const char *name);
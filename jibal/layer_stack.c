@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <jibal_layer_stack.h>
+#include <jibal_stragg.h>
+
+jibal_layer_stack *jibal_layer_stack_new(jibal_gsto *workspace, const jibal_isotope *incident, jibal_layer **layers, size_t n_layers, double E_0, double factor) {
+    if(!workspace || !incident || (n_layers && !layers))
+        return NULL;
+    jibal_layer_stack *stack = malloc(sizeof(jibal_layer_stack));
+    if(!stack)
+        return NULL;
+    stack->workspace = workspace;
+    stack->incident = incident;
+    stack->factor = factor;
+    stack->n_layers = n_layers;
+    stack->layers = layers;
+    stack->E = calloc(n_layers + 1, sizeof(double));
+    stack->S = calloc(n_layers + 1, sizeof(double));
+    stack->n_valid = 0;
+    stack->n_calculated = 0;
+    if(!stack->E || !stack->S) {
+        jibal_layer_stack_free(stack);
+        return NULL;
+    }
+    jibal_layer_stack_set_energy(stack, E_0);
+    return stack;
+}
+
+void jibal_layer_stack_free(jibal_layer_stack *stack) {
+    if(!stack)
+        return;
+    free(stack->E);
+    free(stack->S);
+    free(stack);
+}
+
+void jibal_layer_stack_set_energy(jibal_layer_stack *stack, double E_0) {
+    if(stack->n_valid && stack->E[0] == E_0)
+        return;
+    stack->E[0] = E_0;
+    stack->S[0] = 0.0;
+    stack->n_valid = 1; /* The surface is always valid */
+}
+
+void jibal_layer_stack_invalidate(jibal_layer_stack *stack, size_t i_layer) {
+    if(i_layer >= stack->n_layers)
+        return;
+    if(stack->n_valid > i_layer + 1) { /* Boundary i_layer (entering the changed layer) is still valid */
+        stack->n_valid = i_layer + 1;
+    }
+}
+
+void jibal_layer_stack_set_thickness(jibal_layer_stack *stack, size_t i_layer, double thickness) {
+    if(i_layer >= stack->n_layers)
+        return;
+    jibal_layer *layer = stack->layers[i_layer];
+    if(layer->thickness == thickness)
+        return;
+    layer->thickness = thickness;
+    jibal_layer_stack_invalidate(stack, i_layer);
+}
+
+double jibal_layer_stack_energy(jibal_layer_stack *stack, size_t i_boundary, double *S) {
+    if(i_boundary > stack->n_layers) {
+        i_boundary = stack->n_layers;
+    }
+    while(stack->n_valid <= i_boundary) {
+        size_t i = stack->n_valid - 1; /* Layer between boundaries i and i+1 */
+        double S_layer = stack->S[i];
+        stack->E[i + 1] = jibal_layer_energy_loss_with_straggling(stack->workspace, stack->incident, stack->layers[i], stack->E[i], stack->factor, &S_layer);
+        stack->S[i + 1] = S_layer;
+        stack->n_valid++;
+        stack->n_calculated++;
+    }
+    if(S) {
+        *S = stack->S[i_boundary];
+    }
+    return stack->E[i_boundary];
+}
+
+double jibal_layer_stack_exit_energy(jibal_layer_stack *stack, double *S) {
+    return jibal_layer_stack_energy(stack, stack->n_layers, S);
+}
@@ -23,11 +23,84 @@
 #include <jibal_masses.h>
 #include <jibal_generic.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include "win_compat.h"
 #include "jibal_defaults.h"
 
 //#include "win_compat.h"
 
+typedef struct jibal_isotope_index { /* Built by jibal_isotopes_load(), see masses_isotopes_index() */
+    int Z_max;
+    int A_max;
+    const jibal_isotope **by_ZA; /* (Z_max + 1) * (A_max + 1) pointers, first isotope with Z and A (or NULL) is by_ZA[Z * (A_max + 1) + A] */
+    size_t mask; /* Size of names minus one, size is a power of two */
+    const jibal_isotope **names; /* Hash table (open addressing, linear probing) */
+} jibal_isotope_index;
+
+typedef struct jibal_element_index { /* Built by jibal_elements_populate() */
+    int Z_max;
+    size_t mask;
+    const jibal_element **names;
+} jibal_element_index;
+
+static size_t masses_name_hash(const char *name) { /* FNV-1a of at most JIBAL_ISOTOPE_NAME_LENGTH characters */
+    uint32_t h = 2166136261u;
+    size_t i;
+    for(i = 0; i < JIBAL_ISOTOPE_NAME_LENGTH && name[i] != '\0'; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t masses_hash_size(size_t n) { /* Power of two, at most half full */
+    size_t size = 16;
+    while(size < 2 * n) {
+        size *= 2;
+    }
+    return size;
+}
+
+static void masses_isotopes_index(jibal_isotope *isotopes) {
+    size_t n = jibal_isotopes_n(isotopes), i;
+    if(n == 0) {
+        return;
+    }
+    jibal_isotope_index *index = calloc(1, sizeof(jibal_isotope_index));
+    for(i = 0; i < n; i++) {
+        if(isotopes[i].Z > index->Z_max) {
+            index->Z_max = isotopes[i].Z;
+        }
+        if(isotopes[i].A > index->A_max) {
+            index->A_max = isotopes[i].A;
+        }
+    }
+    index->by_ZA = calloc((size_t)(index->Z_max + 1) * (index->A_max + 1), sizeof(jibal_isotope *));
+    index->mask = masses_hash_size(n) - 1;
+    index->names = calloc(index->mask + 1, sizeof(jibal_isotope *));
+    for(i = 0; i < n; i++) { /* First match wins, like in a linear search */
+        const jibal_isotope *isotope = &isotopes[i];
+        if(isotope->Z >= 0 && isotope->A >= 0) {
+            const jibal_isotope **slot = &index->by_ZA[isotope->Z * (index->A_max + 1) + isotope->A];
+            if(!*slot) {
+                *slot = isotope;
+            }
+        }
+        size_t h;
+        for(h = masses_name_hash(isotope->name) & index->mask; index->names[h]; h = (h + 1) & index->mask) {
+            if(strcmp(index->names[h]->name, isotope->name) == 0) {
+                break;
+            }
+        }
+        if(!index->names[h]) {
+            index->names[h] = isotope;
+        }
+    }
+    for(i = 0; i < n; i++) {
+        isotopes[i].index = index;
+    }
+}
+
 int isotope_set(jibal_isotope *isotope, int Z, int N, int A, double mass, const char *name) {
     if(!isotope) {
         return -1;
@@ -90,6 +163,8 @@ jibal_isotope *jibal_isotopes_load(const char *filename) {
     }
     isotopes = realloc(isotopes, sizeof(jibal_isotope) * (n+1));
     isotope_set(isotopes+n, 0, 0, 0, 0.0, "");
+    isotopes[n].index = NULL;
+    masses_isotopes_index(isotopes);
 #ifdef DEBUG
     fprintf(stderr, "Loaded %zu isotopes from %s\n", n, filename);
 #endif
@@ -127,17 +202,13 @@ int jibal_abundances_load(jibal_isotope *isotopes, const char *filename) {
         if(sscanf(line, "%i %i %lf", &Z, &A, &abundance) != 3) { /* Failure (problem with data). Let's keep the good data anyway. */
             return n;
         }
-        jibal_isotope *isotope;
-        int found = FALSE;
-        for (isotope = isotopes; isotope->A != 0; isotope++) {
-            if(isotope->Z == Z && isotope->A == A) {
-                isotope->abundance = abundance;
-                found = TRUE;
-                break;
-            }
-        }
-        if(!found) {
+        const jibal_isotope *found = jibal_isotope_find(isotopes, NULL, Z, A);
+        jibal_isotope *isotope = found ? &isotopes[found->i] : NULL;
+        if(isotope) {
+            isotope->abundance = abundance;
+        } else {
             fprintf(stderr, "Couldn't find isotope with Z=%i and A=%i\n", Z, A);
+            continue;
         }
 #ifdef DEBUG
         fprintf(stderr, "Abundance of %s is now %.8lf.%s\n", isotope->name, abundance, abundance<ABUNDANCE_THRESHOLD?" WARNING: This is below threshold!":"");
@@ -150,7 +221,161 @@ int jibal_abundances_load(jibal_isotope *isotopes, const char *filename) {
     return n;
 }
 
+static int masses_file_signature(const char *filename, uint64_t *size, int64_t *mtime, uint64_t *hash) { /* Size, modification time and hash of the contents of a file */
+    struct stat st;
+    if(!filename || stat(filename, &st)) {
+        return 0;
+    }
+    FILE *f = fopen(filename, "rb");
+    if(!f) {
+        return 0;
+    }
+    char buf[1 << 16];
+    size_t n, i;
+    uint64_t h = 14695981039346656037u;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for(i = 0; i < n; i++) {
+            h ^= (unsigned char)buf[i];
+            h *= 1099511628211u;
+        }
+    }
+    fclose(f);
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    *hash = h;
+    return 1;
+}
+
+static int masses_cache_header(jibal_masses_cache_header *header, const char *masses_file, const char *abundances_file, size_t n_isotopes) { /* Header corresponding to the current state of the files */
+    memset(header, 0, sizeof(jibal_masses_cache_header));
+    memcpy(header->magic, JIBAL_MASSES_CACHE_MAGIC, sizeof(header->magic));
+    header->version = JIBAL_MASSES_CACHE_VERSION;
+    header->endian_check = JIBAL_MASSES_CACHE_ENDIAN_CHECK;
+    header->n_isotopes = n_isotopes;
+    header->record_size = sizeof(jibal_masses_cache_record);
+    if(!masses_file_signature(masses_file ? masses_file : JIBAL_MASSES_FILE, &header->masses_size, &header->masses_mtime, &header->masses_hash)) {
+        return 0;
+    }
+    if(!masses_file_signature(abundances_file ? abundances_file : JIBAL_ABUNDANCES_FILE, &header->abundances_size, &header->abundances_mtime, &header->abundances_hash)) {
+        return 0;
+    }
+    return 1;
+}
+
+jibal_isotope *jibal_isotopes_from_records(const jibal_masses_cache_record *records, size_t n) {
+    if(n == 0 || n > INT32_MAX) {
+        return NULL;
+    }
+    jibal_isotope *isotopes = calloc(n + 1, sizeof(jibal_isotope));
+    size_t i;
+    for(i = 0; i < n; i++) {
+        const jibal_masses_cache_record *r = &records[i];
+        jibal_isotope *isotope = &isotopes[i];
+        memcpy(isotope->name, r->name, JIBAL_ISOTOPE_NAME_LENGTH);
+        isotope->name[JIBAL_ISOTOPE_NAME_LENGTH - 1] = '\0';
+        isotope->N = r->N;
+        isotope->Z = r->Z;
+        isotope->A = r->A;
+        isotope->mass = r->mass;
+        isotope->abundance = r->abundance;
+        isotope->i = i;
+        if(isotope->A == 0) { /* Would terminate the table */
+            free(isotopes);
+            return NULL;
+        }
+    }
+    masses_isotopes_index(isotopes); /* isotopes[n] is all zeros, like in jibal_isotopes_load() */
+    return isotopes;
+}
+
+jibal_masses_cache_record *jibal_isotopes_to_records(const jibal_isotope *isotopes, size_t *n) {
+    *n = jibal_isotopes_n(isotopes);
+    if(*n == 0) {
+        return NULL;
+    }
+    jibal_masses_cache_record *records = calloc(*n, sizeof(jibal_masses_cache_record));
+    size_t i;
+    for(i = 0; i < *n; i++) {
+        jibal_masses_cache_record *r = &records[i];
+        memcpy(r->name, isotopes[i].name, JIBAL_ISOTOPE_NAME_LENGTH);
+        r->N = isotopes[i].N;
+        r->Z = isotopes[i].Z;
+        r->A = isotopes[i].A;
+        r->mass = isotopes[i].mass;
+        r->abundance = isotopes[i].abundance;
+    }
+    return records;
+}
+
+jibal_isotope *jibal_isotopes_cache_read(const char *filename, const char *masses_file, const char *abundances_file) {
+    jibal_masses_cache_header header, expected;
+    if(!filename) {
+        return NULL;
+    }
+    FILE *f = fopen(filename, "rb");
+    if(!f) {
+        return NULL;
+    }
+    if(fread(&header, sizeof(jibal_masses_cache_header), 1, f) != 1 || header.n_isotopes == 0 || header.n_isotopes > INT32_MAX ||
+       !masses_cache_header(&expected, masses_file, abundances_file, header.n_isotopes) || memcmp(&header, &expected, sizeof(jibal_masses_cache_header)) != 0) {
+#ifdef DEBUG
+        fprintf(stderr, "Masses cache %s is not valid (any more).\n", filename);
+#endif
+        fclose(f);
+        return NULL;
+    }
+    size_t n = header.n_isotopes;
+    jibal_masses_cache_record *records = malloc(sizeof(jibal_masses_cache_record) * n);
+    if(fread(records, sizeof(jibal_masses_cache_record), n, f) != n) { /* All records with one read */
+        free(records);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    jibal_isotope *isotopes = jibal_isotopes_from_records(records, n);
+    free(records);
+    return isotopes;
+}
+
+int jibal_isotopes_cache_write(const jibal_isotope *isotopes, const char *filename, const char *masses_file, const char *abundances_file) {
+    jibal_masses_cache_header header;
+    size_t n = jibal_isotopes_n(isotopes);
+    if(!filename || n == 0 || !masses_cache_header(&header, masses_file, abundances_file, n)) {
+        return 0;
+    }
+    jibal_masses_cache_record *records = jibal_isotopes_to_records(isotopes, &n);
+    char *filename_tmp;
+    FILE *f = jibal_fopen_tmp(filename, &filename_tmp);
+    if(!f) { /* Directory is probably not writable, that is fine. */
+        free(records);
+        return 0;
+    }
+    int success = (fwrite(&header, sizeof(jibal_masses_cache_header), 1, f) == 1 && fwrite(records, sizeof(jibal_masses_cache_record), n, f) == n);
+    free(records);
+    if(fclose(f)) {
+        success = FALSE;
+    }
+#ifdef WIN32
+    remove(filename); /* rename() doesn't replace on Windows */
+#endif
+    if(!success || rename(filename_tmp, filename)) {
+        remove(filename_tmp);
+        success = FALSE;
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Writing masses cache %s %s.\n", filename, success ? "succeeded" : "failed");
+#endif
+    free(filename_tmp);
+    return success;
+}
+
 void jibal_isotopes_free(jibal_isotope *isotopes) {
+    if(isotopes && isotopes->index) {
+        jibal_isotope_index *index = (jibal_isotope_index *)isotopes->index;
+        free(index->by_ZA);
+        free(index->names);
+        free(index);
+    }
     free(isotopes);
 }
 
@@ -215,10 +440,29 @@ jibal_element *jibal_elements_populate(const jibal_isotope *isotopes) {
  * all of the elements. */
         }
     }
+    jibal_element_index *index = calloc(1, sizeof(jibal_element_index));
+    index->Z_max = Z_max;
+    index->mask = masses_hash_size(Z_max + 1) - 1;
+    index->names = calloc(index->mask + 1, sizeof(jibal_element *));
+    for(Z=0; Z <= Z_max; Z++) { /* First match wins, like in a linear search */
+        size_t h;
+        for(h = masses_name_hash(elements[Z].name) & index->mask; index->names[h]; h = (h + 1) & index->mask) {
+            if(strncmp(index->names[h]->name, elements[Z].name, JIBAL_ISOTOPE_NAME_LENGTH) == 0) {
+                break;
+            }
+        }
+        if(!index->names[h]) {
+            index->names[h] = &elements[Z];
+        }
+        elements[Z].index = index;
+    }
     return elements;
 }
 
 int jibal_elements_Zmax(const jibal_element *elements) {
+    if(elements->index) {
+        return ((const jibal_element_index *)elements->index)->Z_max;
+    }
     const jibal_element *e;
     int n=0;
     for(e=elements+1; e->Z != 0; e++) {
@@ -239,6 +483,11 @@ void jibal_element_free(jibal_element *element) {
 void jibal_elements_free(jibal_element *elements) {
     if(!elements)
         return;
+    if(elements->index) {
+        jibal_element_index *index = (jibal_element_index *)elements->index;
+        free(index->names);
+        free(index);
+    }
     jibal_element *e;
     for(e=elements; e->name[0] != '\0'; e++) {
         if(e->n_isotopes > 0 && e->isotopes) {
@@ -257,6 +506,7 @@ jibal_element *jibal_element_new(const element_name name, int Z, int n_isotopes)
     e->n_isotopes=n_isotopes;
     e->isotopes=calloc(n_isotopes, sizeof(jibal_isotope *));
     e->concs=calloc(n_isotopes, sizeof(double));
+    e->index=NULL;
     strncpy(e->name, name, JIBAL_ISOTOPE_NAME_LENGTH);
     return e;
 }
@@ -279,6 +529,16 @@ const jibal_element * jibal_element_find(const jibal_element *elements, const ch
         return &elements[Z];
     }
     const jibal_element *e;
+    if(elements->index) {
+        const jibal_element_index *index = elements->index;
+        size_t h;
+        for(h = masses_name_hash(name) & index->mask; (e = index->names[h]); h = (h + 1) & index->mask) {
+            if(strncmp(e->name, name, JIBAL_ISOTOPE_NAME_LENGTH)==0) {
+                return e;
+            }
+        }
+        return NULL;
+    }
     for(e=elements; e->name[0] != '\0'; e++) {
         if(strncmp(e->name, name, JIBAL_ISOTOPE_NAME_LENGTH)==0) {
             return e;
@@ -395,8 +655,18 @@ const jibal_isotope * jibal_isotope_find(const jibal_isotope *isotopes, const ch
     const jibal_isotope *isotope;
     if(!isotopes)
         return NULL;
+    const jibal_isotope_index *index = isotopes->index;
     if(name != NULL) {
         if (jibal_isdigit(*name)) { /* Isotope names usually start with a mass number */
+            if(index) {
+                size_t h;
+                for(h = masses_name_hash(name) & index->mask; (isotope = index->names[h]); h = (h + 1) & index->mask) {
+                    if (strcmp(isotope->name, name) == 0) {
+                        return isotope;
+                    }
+                }
+                return NULL;
+            }
             for (isotope = isotopes; isotope->A != 0; isotope++) {
                 if (strcmp(isotope->name, name) == 0) {
                     return isotope;
@@ -435,7 +705,10 @@ const jibal_isotope * jibal_isotope_find(const jibal_isotope *isotopes, const ch
                 return NULL;
         }
     }
-    for (isotope = isotopes; isotope->A != 0; isotope++) {
+    if(index && Z >= 0 && Z <= index->Z_max && A >= 0 && A <= index->A_max) {
+        return index->by_ZA[Z * (index->A_max + 1) + A];
+    }
+    for (isotope = isotopes; isotope->A != 0; isotope++) { /* Not indexed, or out of range of the index */
         if(isotope->Z == Z && isotope->A == A) {
             return isotope;
         }
@@ -447,6 +720,12 @@ const char *jibal_element_name(const jibal_element *elements, int Z) {
     if(Z == JIBAL_ANY_Z)
         return "Any";
     const jibal_element *e;
+    if(elements->index) {
+        if(Z >= 0 && Z <= ((const jibal_element_index *)elements->index)->Z_max) {
+            return elements[Z].name; /* elements[Z].Z == Z */
+        }
+        return "Err";
+    }
     for(e=elements; e->name[0] != '\0'; e++) {
         if(e->Z == Z) {
             return e->name;
@@ -0,0 +1,311 @@
+/*
+    Jyväskylä Ion Beam Analysis Library (JIBAL)
+    Copyright (C) 2020 - 2026 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <jibal_range.h>
+
+static double range_bin_path(double S_i, double slope, double dE) { /* Integral of 1/S from E_i to E_i + dE, when S = S_i + slope*(E - E_i) */
+    if(slope == 0.0) {
+        return dE / S_i;
+    }
+    return log1p(slope * dE / S_i) / slope;
+}
+
+static double range_bin_energy(double S_i, double slope, double dX) { /* Inverse of range_bin_path(), returns dE */
+    if(slope == 0.0) {
+        return S_i * dX;
+    }
+    return S_i * expm1(slope * dX) / slope;
+}
+
+static inline double range_weight_integrand(double stragg, double S) {
+#ifndef NO_NON_STATISTICAL_BROADENING
+    return stragg / (S * S * S);
+#else
+    return stragg / S;
+#endif
+}
+
+static double range_weight(const jibal_range *range, double E) { /* W(E), see jibal_range */
+    const jibal_stop_table *t = range->table;
+    int lo = jibal_stop_table_index(t, E);
+    if(lo >= 0) { /* Simpson's rule from E[lo] to E */
+        double E_mid = (t->E[lo] + E) / 2.0;
+        double f_lo = range_weight_integrand(t->stragg[lo], t->S[lo]);
+        double f_mid = range_weight_integrand(jibal_stop_table_get_stragg(t, E_mid), jibal_stop_table_get(t, E_mid));
+        double f = range_weight_integrand(jibal_stop_table_get_stragg(t, E), jibal_stop_table_get(t, E));
+        return range->W[lo] + (E - t->E[lo]) / 6.0 * (f_lo + 4.0 * f_mid + f);
+    }
+    if(!t->extrapolate) {
+        return NAN;
+    }
+    if(E > 0.0 && E < t->E_min) { /* Both stopping and straggling are proportional to E */
+#ifndef NO_NON_STATISTICAL_BROADENING
+        return t->stragg[0] * t->E_min * t->E_min / pow(t->S[0], 3.0) * (1.0 / t->E_min - 1.0 / E);
+#else
+        return (E - t->E_min) * t->stragg[0] / t->S[0];
+#endif
+    }
+    if(E > t->E_max) {
+        return range->W[t->n - 1] + (E - t->E_max) * range_weight_integrand(t->stragg[t->n - 1], t->S[t->n - 1]);
+    }
+    return NAN;
+}
+
+jibal_range *jibal_range_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, size_t n) {
+    jibal_stop_table *table = jibal_stop_table_new(workspace, incident, target, n);
+    if(!table) {
+        return NULL;
+    }
+    size_t i;
+    for(i = 0; i < table->n; i++) {
+        if(!(table->S[i] > 0.0)) {
+            fprintf(stderr, "Can not make a range table for %s in %s, stopping is not positive at E = %g keV.\n",
+                    incident->name, target->name, table->E[i] / C_KEV);
+            jibal_stop_table_free(table);
+            return NULL;
+        }
+    }
+    jibal_range *range = malloc(sizeof(jibal_range));
+    range->table = table;
+    range->material = jibal_material_copy(target);
+    range->X = malloc(sizeof(double) * table->n);
+    range->X[0] = 0.0;
+    for(i = 0; i < table->n - 1; i++) {
+        double dE = table->E[i + 1] - table->E[i];
+        double slope = (table->S[i + 1] - table->S[i]) / dE;
+        range->X[i + 1] = range->X[i] + range_bin_path(table->S[i], slope, dE);
+    }
+    range->W = NULL;
+    if(table->stragg) {
+        range->W = malloc(sizeof(double) * table->n);
+        range->W[0] = 0.0;
+        for(i = 0; i < table->n - 1; i++) {
+            double f_mid = range_weight_integrand((table->stragg[i] + table->stragg[i + 1]) / 2.0, (table->S[i] + table->S[i + 1]) / 2.0);
+            range->W[i + 1] = range->W[i] + (table->E[i + 1] - table->E[i]) / 6.0 *
+                              (range_weight_integrand(table->stragg[i], table->S[i]) + 4.0 * f_mid + range_weight_integrand(table->stragg[i + 1], table->S[i + 1]));
+        }
+    }
+#ifdef DEBUG
+    fprintf(stderr, "Range table for %s in %s: %zu points, path length from %g keV to %g keV is %g tfu\n", incident->name,
+            target->name, table->n, table->E_min / C_KEV, table->E_max / C_KEV, range->X[table->n - 1] / C_TFU);
+#endif
+    return range;
+}
+
+void jibal_range_free(jibal_range *range) {
+    if(!range) {
+        return;
+    }
+    jibal_stop_table_free(range->table);
+    jibal_material_free(range->material);
+    free(range->X);
+    free(range->W);
+    free(range);
+}
+
+double jibal_range_path(const jibal_range *range, double E) {
+    const jibal_stop_table *t = range->table;
+    int lo = jibal_stop_table_index(t, E);
+    if(lo >= 0) {
+        double slope = (t->S[lo + 1] - t->S[lo]) / (t->E[lo + 1] - t->E[lo]);
+        return range->X[lo] + range_bin_path(t->S[lo], slope, E - t->E[lo]);
+    }
+    if(!t->extrapolate) {
+        return NAN;
+    }
+    if(E > 0.0 && E < t->E_min) { /* Stopping is proportional to E */
+        return log(E / t->E_min) * t->E_min / t->S[0];
+    }
+    if(E > t->E_max) { /* Stopping is constant */
+        return range->X[t->n - 1] + (E - t->E_max) / t->S[t->n - 1];
+    }
+    return NAN;
+}
+
+double jibal_range_energy(const jibal_range *range, double X) {
+    const jibal_stop_table *t = range->table;
+    if(!(X >= 0.0 && X <= range->X[t->n - 1])) {
+        if(!t->extrapolate || isnan(X)) {
+            return 0.0;
+        }
+        if(X < 0.0) {
+            return t->E_min * exp(X * t->S[0] / t->E_min);
+        }
+        return t->E_max + (X - range->X[t->n - 1]) * t->S[t->n - 1];
+    }
+    size_t lo = 0, hi = t->n - 1;
+    while(hi - lo > 1) { /* Binary search, X[lo] <= X < X[hi] */
+        size_t mid = (lo + hi) / 2;
+        if(range->X[mid] <= X) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    double slope = (t->S[lo + 1] - t->S[lo]) / (t->E[lo + 1] - t->E[lo]);
+    return t->E[lo] + range_bin_energy(t->S[lo], slope, X - range->X[lo]);
+}
+
+double jibal_range_energy_loss(const jibal_range *range, double thickness, double E_0, double factor) {
+    double X_0 = jibal_range_path(range, E_0);
+    if(isnan(X_0)) {
+        return 0.0;
+    }
+    double E = jibal_range_energy(range, X_0 + factor * thickness); /* dX/dx = factor, since dE/dx = factor*S and dX/dE = 1/S */
+    if(!isnormal(E)) {
+        return 0.0;
+    }
+    return E;
+}
+
+double jibal_range_energy_loss_with_straggling(const jibal_range *range, double thickness, double E_0, double factor, double *S) {
+    if(factor == 0.0) {
+        if(range->W) {
+            *S += thickness * jibal_stop_table_get_stragg(range->table, E_0);
+        }
+        return E_0;
+    }
+    double E = jibal_range_energy_loss(range, thickness, E_0, factor);
+    if(E == 0.0) {
+        return 0.0;
+    }
+    double dW = 0.0; /* Integral of stragg/S^2 dx over the layer (or stragg dx). Without straggling data only the non-statistical broadening applies. */
+    if(range->W) {
+        dW = (range_weight(range, E) - range_weight(range, E_0)) / factor;
+    }
+#ifndef NO_NON_STATISTICAL_BROADENING
+    double S_0 = jibal_stop_table_get(range->table, E_0);
+    double S_1 = jibal_stop_table_get(range->table, E);
+    *S = S_1 * S_1 * (*S / (S_0 * S_0) + dW);
+#else
+    *S += dW;
+#endif
+    return E;
+}
+
+double jibal_range_thickness(const jibal_range *range, double E_0, double E, double factor) {
+    if(factor == 0.0) {
+        return NAN;
+    }
+    double thickness = (jibal_range_path(range, E) - jibal_range_path(range, E_0)) / factor;
+    if(!(thickness >= 0.0)) {
+        return NAN;
+    }
+    return thickness;
+}
+
+jibal_range_cache *jibal_range_cache_new(jibal_gsto *workspace) {
+    jibal_range_cache *cache = malloc(sizeof(jibal_range_cache));
+    cache->workspace = workspace;
+    cache->n_ranges = 0;
+    cache->n_ranges_allocated = JIBAL_RANGE_CACHE_SIZE_INITIAL;
+    cache->ranges = malloc(sizeof(jibal_range *) * cache->n_ranges_allocated);
+    cache->hits = 0;
+    cache->misses = 0;
+    return cache;
+}
+
+void jibal_range_cache_free(jibal_range_cache *cache) {
+    if(!cache) {
+        return;
+    }
+    jibal_range_cache_clear(cache);
+    free(cache->ranges);
+    free(cache);
+}
+
+void jibal_range_cache_clear(jibal_range_cache *cache) {
+    for(size_t i = 0; i < cache->n_ranges; i++) {
+        jibal_range_free(cache->ranges[i]);
+    }
+    cache->n_ranges = 0;
+}
+
+static double range_cache_isotope_conc(const jibal_element *element, size_t i) { /* Copies (see jibal_element_copy()) always have concs */
+    return element->concs ? element->concs[i] : element->isotopes[i]->abundance;
+}
+
+static int range_cache_element_match(const jibal_element *a, const jibal_element *b) { /* Same isotopic composition */
+    if(a->Z != b->Z || a->n_isotopes != b->n_isotopes) {
+        return FALSE;
+    }
+    for(size_t i = 0; i < a->n_isotopes; i++) {
+        if(a->isotopes[i] != b->isotopes[i] || range_cache_isotope_conc(a, i) != range_cache_isotope_conc(b, i)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static int range_cache_match(const jibal_range *range, const jibal_isotope *incident, const jibal_material *target) {
+    if(range->table->incident != incident || range->material->n_elements != target->n_elements) {
+        return FALSE;
+    }
+    for(size_t i = 0; i < target->n_elements; i++) {
+        if(range->material->concs[i] != target->concs[i] || !range_cache_element_match(&range->material->elements[i], &target->elements[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+const jibal_range *jibal_range_cache_get(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_material *target) {
+    size_t i;
+    for(i = 0; i < cache->n_ranges; i++) { /* Linear search, there are usually only a few combinations */
+        if(range_cache_match(cache->ranges[i], incident, target)) {
+            cache->hits++;
+            if(i > 0) { /* Move towards the front, so frequently used ranges are found faster */
+                jibal_range *tmp = cache->ranges[i - 1];
+                cache->ranges[i - 1] = cache->ranges[i];
+                cache->ranges[i] = tmp;
+                i--;
+            }
+            return cache->ranges[i];
+        }
+    }
+    cache->misses++;
+    jibal_range *range = jibal_range_new(cache->workspace, incident, target, 0);
+    if(!range) {
+        return NULL;
+    }
+    if(cache->n_ranges == cache->n_ranges_allocated) {
+        cache->n_ranges_allocated *= 2;
+        cache->ranges = realloc(cache->ranges, sizeof(jibal_range *) * cache->n_ranges_allocated);
+    }
+    cache->ranges[cache->n_ranges] = range;
+    cache->n_ranges++;
+    return range;
+}
+
+double jibal_range_cache_layer_energy_loss(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor) {
+    const jibal_range *range = jibal_range_cache_get(cache, incident, layer->material);
+    if(!range) {
+        return 0.0;
+    }
+    return jibal_range_energy_loss(range, layer->thickness, E_0, factor);
+}
+
+double jibal_range_cache_layer_energy_loss_with_straggling(jibal_range_cache *cache, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor, double *S) {
+    const jibal_range *range = jibal_range_cache_get(cache, incident, layer->material);
+    if(!range) {
+        return 0.0;
+    }
+    return jibal_range_energy_loss_with_straggling(range, layer->thickness, E_0, factor, S);
+}
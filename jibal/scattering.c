@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <math.h>
+#include <jibal_scattering.h>
+#include <jibal_kin.h>
+#include <jibal_units.h>
+
+#define JIBAL_SCATTERING_N_ARRAYS 11
+
+static size_t jibal_scattering_n_isotopes(const jibal_material *material) {
+    size_t n = 0;
+    for(size_t i = 0; i < material->n_elements; i++) {
+        n += material->elements[i].n_isotopes;
+    }
+    return n;
+}
+
+jibal_scattering *jibal_scattering_new(const jibal_isotope *incident, const jibal_material *material, double theta, jibal_cross_section_type cs_rbs, jibal_cross_section_type cs_erd) {
+    if(!incident || !material)
+        return NULL;
+    size_t n = jibal_scattering_n_isotopes(material);
+    jibal_scattering *s = malloc(sizeof(jibal_scattering));
+    if(!s)
+        return NULL;
+    s->incident = incident;
+    s->theta = theta;
+    s->cs_rbs = cs_rbs;
+    s->cs_erd = cs_erd;
+    s->erd = cos(theta) > 0.0;
+    s->n_isotopes = n;
+    s->isotopes = malloc(sizeof(jibal_isotope *) * (n ? n : 1));
+    s->conc = calloc(JIBAL_SCATTERING_N_ARRAYS * (n ? n : 1), sizeof(double)); /* All arrays share this allocation */
+    if(!s->isotopes || !s->conc) {
+        jibal_scattering_free(s);
+        return NULL;
+    }
+    s->theta_max = s->conc + n;
+    s->K_plus = s->theta_max + n;
+    s->K_minus = s->K_plus + n;
+    s->K_erd = s->K_minus + n;
+    s->rbs_sigma_factor = s->K_erd + n;
+    s->rbs_andersen_a = s->rbs_sigma_factor + n;
+    s->rbs_andersen_b = s->rbs_andersen_a + n;
+    s->erd_sigma_factor = s->rbs_andersen_b + n;
+    s->erd_andersen_a = s->erd_sigma_factor + n;
+    s->erd_andersen_b = s->erd_andersen_a + n;
+    size_t i = 0;
+    for(size_t i_elem = 0; i_elem < material->n_elements; i_elem++) {
+        const jibal_element *e = &material->elements[i_elem];
+        for(size_t i_isotope = 0; i_isotope < e->n_isotopes; i_isotope++, i++) {
+            const jibal_isotope *isotope = e->isotopes[i_isotope];
+            jibal_cross_section cs;
+            double c = material->concs[i_elem] * e->concs[i_isotope];
+            s->isotopes[i] = isotope;
+            s->conc[i] = c;
+            s->theta_max[i] = incident->mass < isotope->mass ? C_PI : asin(isotope->mass/incident->mass);
+            if(jibal_cross_section_rbs_init(&cs, incident, isotope, theta, cs_rbs)) {
+                s->K_plus[i] = jibal_kin_rbs(incident->mass, isotope->mass, theta, '+');
+                if(incident->mass > isotope->mass) {
+                    s->K_minus[i] = jibal_kin_rbs(incident->mass, isotope->mass, theta, '-');
+                }
+                s->rbs_sigma_factor[i] = c * cs.sigma_factor;
+                s->rbs_andersen_a[i] = cs.andersen_a;
+                s->rbs_andersen_b[i] = cs.andersen_b;
+            }
+            if(s->erd && jibal_cross_section_erd_init(&cs, incident, isotope, theta, cs_erd)) {
+                s->K_erd[i] = jibal_kin_erd(incident->mass, isotope->mass, theta);
+                s->erd_sigma_factor[i] = c * cs.sigma_factor;
+                s->erd_andersen_a[i] = cs.andersen_a;
+                s->erd_andersen_b[i] = cs.andersen_b;
+            }
+        }
+    }
+    return s;
+}
+
+void jibal_scattering_free(jibal_scattering *scattering) {
+    if(!scattering)
+        return;
+    free(scattering->isotopes);
+    free(scattering->conc);
+    free(scattering);
+}
+
+static double jibal_scattering_cs(jibal_cross_section_type type, size_t n, const double *sigma_factor, const double *andersen_a, const double *andersen_b, double E, double *sigma) {
+    double E_inv = 1.0/E;
+    double E_inv2 = E_inv * E_inv;
+    double sum = 0.0;
+    if(type == JIBAL_CS_ANDERSEN) {
+        for(size_t i = 0; i < n; i++) {
+            double r_VE = andersen_a[i] * E_inv;
+            double b = andersen_b[i] * r_VE;
+            double F = (1.0 + 0.5 * r_VE) / (1.0 + r_VE + b * b);
+            double x = sigma_factor[i] * E_inv2 * F * F;
+            if(sigma)
+                sigma[i] = x;
+            sum += x;
+        }
+    } else {
+        for(size_t i = 0; i < n; i++) {
+            double x = sigma_factor[i] * E_inv2;
+            if(sigma)
+                sigma[i] = x;
+            sum += x;
+        }
+    }
+    return sum;
+}
+
+double jibal_scattering_rbs(const jibal_scattering *scattering, double E, double *sigma) {
+    return jibal_scattering_cs(scattering->cs_rbs, scattering->n_isotopes, scattering->rbs_sigma_factor, scattering->rbs_andersen_a, scattering->rbs_andersen_b, E, sigma);
+}
+
+double jibal_scattering_erd(const jibal_scattering *scattering, double E, double *sigma) {
+    return jibal_scattering_cs(scattering->cs_erd, scattering->n_isotopes, scattering->erd_sigma_factor, scattering->erd_andersen_a, scattering->erd_andersen_b, E, sigma);
+}
@@ -1,4 +1,9 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 #include <jibal_stop.h>
+#include <jibal_stragg.h>
+#include "thread_compat.h"
 
 
 double jibal_gsto_stop_em(jibal_gsto *workspace, int Z1, int Z2, double em) {
@@ -15,18 +20,284 @@ double jibal_stop(jibal_gsto *workspace, const jibal_isotope *incident, const ji
     return jibal_stop_nuc(incident, target, E) + jibal_stop_ele(workspace, incident, target, E); /* This returns a POSITIVE value (-dE/dx) in SI units for stopping cross section, e.g. J/(1/m^2) = J m^2 */
 }
 
+double jibal_stop_with_ctx(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, const jibal_stop_nuc_ctx *nuc, double E) {
+    return jibal_stop_nuc_ctx_get(nuc, E) + jibal_stop_ele(workspace, incident, target, E);
+}
+
+static double stop_nuc_reduced(double epsilon, int high) { /* Universal reduced nuclear stopping. Formula changes at
+ * epsilon = 30, if high is TRUE the high energy formula is used at epsilon = 30 exactly (limit from above). */
+    if(epsilon < 30.0 || (epsilon == 30.0 && !high)) {
+        return log(1+1.1383*epsilon)/(2*(epsilon+0.01321*pow(epsilon, 0.21226)+0.19593*pow(epsilon, 0.5)));
+    } else {
+        return log(epsilon)/(2*epsilon);
+    }
+}
+
+double jibal_stop_nuc_reduced(double epsilon) {
+    return stop_nuc_reduced(epsilon, FALSE);
+}
+
+static double *stop_nuc_table_make(void) { /* Bins are uniform within each octave of epsilon, bin i has two values: g
+ * at the start of the bin (a) and the change of g over the bin (b), where g(epsilon) = epsilon*S_n(epsilon). */
+    size_t n_bins = (JIBAL_STOP_NUC_TABLE_EXP_MAX - JIBAL_STOP_NUC_TABLE_EXP_MIN) * JIBAL_STOP_NUC_TABLE_BINS;
+    double *table = malloc(sizeof(double) * 2 * n_bins);
+    size_t i = 0;
+    for(int k = JIBAL_STOP_NUC_TABLE_EXP_MIN; k < JIBAL_STOP_NUC_TABLE_EXP_MAX; k++) {
+        for(int j = 0; j < JIBAL_STOP_NUC_TABLE_BINS; j++) {
+            double eps_lo = ldexp(1.0 + 1.0 * j / JIBAL_STOP_NUC_TABLE_BINS, k - 1);
+            double eps_hi = ldexp(1.0 + 1.0 * (j + 1) / JIBAL_STOP_NUC_TABLE_BINS, k - 1);
+            double g_lo = eps_lo * stop_nuc_reduced(eps_lo, TRUE);
+            double g_hi = eps_hi * stop_nuc_reduced(eps_hi, FALSE);
+            table[2 * i] = g_lo;
+            table[2 * i + 1] = g_hi - g_lo;
+            i++;
+        }
+    }
+    return table;
+}
+
+static const double *stop_nuc_table(void) { /* Table is shared by everyone and made on first use. It is never freed. */
+    static double *table = NULL;
+    double *t = jibal_atomic_load_ptr(&table);
+    if(t) {
+        return t;
+    }
+    t = stop_nuc_table_make();
+    if(!jibal_atomic_cas_ptr(&table, NULL, t)) { /* Another thread was faster */
+        free(t);
+        t = jibal_atomic_load_ptr(&table);
+    }
+    return t;
+}
+
+static inline double stop_nuc_reduced_table(const double *table, double epsilon) {
+    int k;
+    double m = frexp(epsilon, &k); /* epsilon = m*2^k, 0.5 <= m < 1 */
+    if(k < JIBAL_STOP_NUC_TABLE_EXP_MIN || k >= JIBAL_STOP_NUC_TABLE_EXP_MAX) { /* Also handles zero, negative and non-finite values */
+        return epsilon > 0.0 ? jibal_stop_nuc_reduced(epsilon) : 0.0;
+    }
+    double x = (2.0 * m - 1.0) * JIBAL_STOP_NUC_TABLE_BINS;
+    int j = (int) x;
+    const double *bin = table + 2 * ((k - JIBAL_STOP_NUC_TABLE_EXP_MIN) * JIBAL_STOP_NUC_TABLE_BINS + j);
+    return (bin[0] + bin[1] * (x - j)) / epsilon;
+}
+
+static inline double stop_nuc_reduced_table_deriv(const double *table, double epsilon, double *deriv) { /* Same as
+ * stop_nuc_reduced_table(), derivative dS_n/depsilon is stored in deriv */
+    int k;
+    double m = frexp(epsilon, &k);
+    if(k < JIBAL_STOP_NUC_TABLE_EXP_MIN || k >= JIBAL_STOP_NUC_TABLE_EXP_MAX) {
+        if(!(epsilon > 0.0)) {
+            *deriv = 0.0;
+            return 0.0;
+        }
+        double d = epsilon * 1e-6; /* Numerical derivative, this is rare */
+        *deriv = (jibal_stop_nuc_reduced(epsilon + d) - jibal_stop_nuc_reduced(epsilon - d)) / (2.0 * d);
+        return jibal_stop_nuc_reduced(epsilon);
+    }
+    double x = (2.0 * m - 1.0) * JIBAL_STOP_NUC_TABLE_BINS;
+    int j = (int) x;
+    const double *bin = table + 2 * ((k - JIBAL_STOP_NUC_TABLE_EXP_MIN) * JIBAL_STOP_NUC_TABLE_BINS + j);
+    double S_n = (bin[0] + bin[1] * (x - j)) / epsilon;
+    *deriv = (bin[1] * ldexp(2.0 * JIBAL_STOP_NUC_TABLE_BINS, -k) - S_n) / epsilon; /* dx/depsilon = 2*BINS/2^k */
+    return S_n;
+}
+
+double jibal_stop_nuc_reduced_fast(double epsilon) {
+    return stop_nuc_reduced_table(stop_nuc_table(), epsilon);
+}
+
+static void stop_nuc_pair_set(jibal_stop_nuc_pair *pair, int Z1, double m1, int Z2, double m2, double conc) {
+    /* Same physics as jibal_gsto_stop_nuclear_universal(), which is S = S_n(epsilon)*pi*a_u^2*gamma*E/epsilon. */
+    double z = pow(Z1, 0.23) + pow(Z2, 0.23);
+    double a_u = 0.8854 * C_BOHR_RADIUS / z;
+    double gamma = 4.0 * m1 * m2 / ((m1 + m2) * (m1 + m2));
+    pair->eps_per_E = 32.53 * m2 / (C_KEV * Z1 * Z2 * (m1 + m2) * z);
+    pair->S_factor = conc * C_PI * a_u * a_u * gamma / pair->eps_per_E;
+}
+
+jibal_stop_nuc_ctx *jibal_stop_nuc_ctx_new(const jibal_isotope *incident, const jibal_material *target, int isotopes) {
+    if(!incident || !target) {
+        return NULL;
+    }
+    size_t i, j, n = 0;
+    for(i = 0; i < target->n_elements; i++) {
+        n += isotopes ? target->elements[i].n_isotopes : 1;
+    }
+    jibal_stop_nuc_ctx *ctx = malloc(sizeof(jibal_stop_nuc_ctx));
+    ctx->table = stop_nuc_table();
+    ctx->pairs = malloc(sizeof(jibal_stop_nuc_pair) * (n ? n : 1));
+    ctx->n_pairs = 0;
+    for(i = 0; i < target->n_elements; i++) {
+        const jibal_element *element = &target->elements[i];
+        if(!isotopes) {
+            stop_nuc_pair_set(&ctx->pairs[ctx->n_pairs], incident->Z, incident->mass, element->Z, element->avg_mass, target->concs[i]);
+            ctx->n_pairs++;
+            continue;
+        }
+        for(j = 0; j < element->n_isotopes; j++) {
+            stop_nuc_pair_set(&ctx->pairs[ctx->n_pairs], incident->Z, incident->mass, element->Z, element->isotopes[j]->mass, target->concs[i] * element->concs[j]);
+            ctx->n_pairs++;
+        }
+    }
+    return ctx;
+}
+
+void jibal_stop_nuc_ctx_free(jibal_stop_nuc_ctx *ctx) {
+    if(!ctx) {
+        return;
+    }
+    free(ctx->pairs);
+    free(ctx);
+}
+
+double jibal_stop_nuc_ctx_get(const jibal_stop_nuc_ctx *ctx, double E) {
+    double sum = 0.0;
+    for(size_t i = 0; i < ctx->n_pairs; i++) {
+        const jibal_stop_nuc_pair *pair = &ctx->pairs[i];
+        sum += pair->S_factor * stop_nuc_reduced_table(ctx->table, pair->eps_per_E * E);
+    }
+    return sum;
+}
+
+double jibal_stop_nuc_ctx_get_deriv(const jibal_stop_nuc_ctx *ctx, double E, double *dSdE) {
+    double sum = 0.0, deriv_sum = 0.0;
+    for(size_t i = 0; i < ctx->n_pairs; i++) {
+        const jibal_stop_nuc_pair *pair = &ctx->pairs[i];
+        double deriv;
+        sum += pair->S_factor * stop_nuc_reduced_table_deriv(ctx->table, pair->eps_per_E * E, &deriv);
+        deriv_sum += pair->S_factor * pair->eps_per_E * deriv;
+    }
+    *dSdE = deriv_sum;
+    return sum;
+}
+
+jibal_stop_kernel *jibal_stop_kernel_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target) {
+    if(!workspace || !incident || !target) {
+        return NULL;
+    }
+    jibal_stop_kernel *kernel = malloc(sizeof(jibal_stop_kernel));
+    jibal_gsto_cache_pin(workspace); /* Data the cursors point to must not be freed */
+    kernel->workspace = workspace;
+    kernel->incident = incident;
+    kernel->n_elements = target->n_elements;
+    kernel->elements = calloc(target->n_elements ? target->n_elements : 1, sizeof(jibal_stop_kernel_element));
+    kernel->nuc = jibal_stop_nuc_ctx_new(incident, target, JIBAL_STOP_NUC_ISOTOPES);
+    for(size_t i = 0; i < target->n_elements; i++) {
+        jibal_stop_kernel_element *e = &kernel->elements[i];
+        int Z2 = target->elements[i].Z;
+        e->conc = target->concs[i];
+        e->Z2 = Z2;
+        if(!jibal_gsto_cursor_init(&e->sto, workspace, GSTO_STO_ELE, incident->Z, Z2)) {
+            assert(workspace->lazy); /* Stopping must be assigned and loaded, unless lazy loading is used */
+        }
+        jibal_gsto_cursor_init(&e->stragg, workspace, GSTO_STO_STRAGG, incident->Z, Z2);
+        e->shared_grid = e->sto.file && e->stragg.file && (e->sto.em == e->stragg.em ||
+                (e->sto.xpoints == e->stragg.xpoints && memcmp(e->sto.em, e->stragg.em, sizeof(double) * e->sto.xpoints) == 0));
+    }
+    return kernel;
+}
+
+void jibal_stop_kernel_free(jibal_stop_kernel *kernel) {
+    if(!kernel) {
+        return;
+    }
+    jibal_stop_nuc_ctx_free(kernel->nuc);
+    free(kernel->elements);
+    jibal_gsto_cache_unpin(kernel->workspace);
+    free(kernel);
+}
+
+static inline double stop_kernel_interpolate(const jibal_gsto_cursor *cursor, int lo, double em, double *slope) {
+    /* Same as jibal_gsto_cursor_get_em() for a known bin lo, slope is d/d(em) */
+    const double *e = cursor->em;
+    if(lo < 0) {
+        *slope = 0.0;
+        if(cursor->extrapolate) {
+            if(em >= 0 && em <= e[0]) {
+                *slope = cursor->factor * jibal_gsto_cursor_data(cursor, 0) / e[0];
+                return cursor->factor * jibal_linear_interpolation(0.0, e[0], 0.0, jibal_gsto_cursor_data(cursor, 0), em);
+            }
+            if(em >= e[cursor->xpoints - 1]) {
+                return cursor->factor * jibal_gsto_cursor_data(cursor, cursor->xpoints - 1);
+            }
+        }
+        return 0.0;
+    }
+    if(cursor->points) { /* Interleaved, no division */
+        const gsto_point *p = &cursor->points[lo];
+        *slope = cursor->factor * p->slope;
+        return cursor->factor * (p->y + p->slope * (em - p->em));
+    }
+    double y_lo = jibal_gsto_cursor_data(cursor, lo), y_hi = jibal_gsto_cursor_data(cursor, lo + 1);
+    *slope = cursor->factor * (y_hi - y_lo) / (e[lo + 1] - e[lo]);
+    return cursor->factor * jibal_linear_interpolation(e[lo], e[lo + 1], y_lo, y_hi, em);
+}
+
+double jibal_stop_kernel_stop(jibal_stop_kernel *kernel, double E) {
+    double em = E / kernel->incident->mass;
+    double sum = jibal_stop_nuc_ctx_get(kernel->nuc, E);
+    for(size_t i = 0; i < kernel->n_elements; i++) {
+        jibal_stop_kernel_element *e = &kernel->elements[i];
+        sum += e->conc * jibal_gsto_cursor_get_em(&e->sto, em);
+    }
+    return sum;
+}
+
+double jibal_stop_kernel_stragg(jibal_stop_kernel *kernel, double E) {
+    double em = E / kernel->incident->mass;
+    double sum = 0.0;
+    for(size_t i = 0; i < kernel->n_elements; i++) {
+        jibal_stop_kernel_element *e = &kernel->elements[i];
+        sum += e->conc * jibal_gsto_cursor_get_em(&e->stragg, em);
+    }
+    return sum;
+}
+
+void jibal_stop_kernel_eval(jibal_stop_kernel *kernel, double E, jibal_stop_kernel_result *result) {
+    double mass = kernel->incident->mass;
+    double em = E / mass;
+    double dSdE_nuc;
+    double S = jibal_stop_nuc_ctx_get_deriv(kernel->nuc, E, &dSdE_nuc);
+    double dSdem = 0.0, stragg = 0.0, dstraggdem = 0.0;
+    double slope;
+    for(size_t i = 0; i < kernel->n_elements; i++) {
+        jibal_stop_kernel_element *e = &kernel->elements[i];
+        int lo = -1;
+        if(e->sto.file) {
+            lo = jibal_gsto_cursor_index(&e->sto, em);
+            S += e->conc * stop_kernel_interpolate(&e->sto, lo, em, &slope);
+            dSdem += e->conc * slope;
+        }
+        if(e->stragg.file) {
+            if(!e->shared_grid) {
+                lo = jibal_gsto_cursor_index(&e->stragg, em);
+            }
+            stragg += e->conc * stop_kernel_interpolate(&e->stragg, lo, em, &slope);
+            dstraggdem += e->conc * slope;
+        }
+    }
+    result->S = S;
+    result->dSdE = dSdE_nuc + dSdem / mass;
+    result->stragg = stragg;
+    result->dstraggdE = dstraggdem / mass;
+}
+
 double jibal_stop_nuc(const jibal_isotope *incident, const jibal_material *target, double E) {
     size_t i;
     double sum = 0.0;
+    const double *table = stop_nuc_table();
+    jibal_stop_nuc_pair pair;
     for (i = 0; i < target->n_elements; i++) {
-        jibal_element *element = &target->elements[i];
+        const jibal_element *element = &target->elements[i];
 #ifndef NUCLEAR_STOPPING_ISOTOPES
-        sum += target->concs[i]*jibal_gsto_stop_nuclear_universal(E, incident->Z, incident->mass, element->Z, element->avg_mass);
+        stop_nuc_pair_set(&pair, incident->Z, incident->mass, element->Z, element->avg_mass, target->concs[i]);
+        sum += pair.S_factor * stop_nuc_reduced_table(table, pair.eps_per_E * E);
 #else
-        int j;
+        size_t j;
         for(j=0; j < element->n_isotopes; j++) { /* It would probably suffice to calculate the nuclear stopping with an average mass... */
-            const jibal_isotope *isotope = element->isotopes[j];
-            sum += target->concs[i]*element->concs[j]*gsto_sto_nuclear_universal(E, incident->Z, incident->mass, element->Z, isotope->mass);
+            stop_nuc_pair_set(&pair, incident->Z, incident->mass, element->Z, element->isotopes[j]->mass, target->concs[i] * element->concs[j]);
+            sum += pair.S_factor * stop_nuc_reduced_table(table, pair.eps_per_E * E);
         }
 #endif
     }
@@ -38,9 +309,13 @@ E_0, double factor) {
     double E = E_0;
     double x;
     double h = workspace->stop_step;
+    if(workspace->stop_tolerance > 0.0) {
+        return jibal_layer_energy_loss_adaptive(workspace, incident, layer, E_0, factor, workspace->stop_tolerance, NULL, NULL);
+    }
 #ifdef DEBUG
     fprintf(stderr, "Thickness %g, stop step %g, E = %.3lf keV\n", layer->thickness, h, E/C_KEV);
 #endif
+    jibal_stop_kernel *kernel = jibal_stop_kernel_new(workspace, incident, layer->material);
     for (x = 0.0; x <= layer->thickness; x += h) {
         if(x+h > layer->thickness) { /* Last step may be partial */
             h=layer->thickness-x;
@@ -50,17 +325,114 @@ E_0, double factor) {
         }
 #ifndef NO_RUNGE_KUTTA
         double k1, k2, k3, k4;
-        k1 = factor*jibal_stop(workspace, incident, layer->material, E);
-        k2 = factor*jibal_stop(workspace, incident, layer->material, E + (h / 2) * k1);
-        k3 = factor*jibal_stop(workspace, incident, layer->material, E + (h / 2) * k2);
-        k4 = factor*jibal_stop(workspace, incident, layer->material, E + h * k3);
+        k1 = factor*jibal_stop_kernel_stop(kernel, E);
+        k2 = factor*jibal_stop_kernel_stop(kernel, E + (h / 2) * k1);
+        k3 = factor*jibal_stop_kernel_stop(kernel, E + (h / 2) * k2);
+        k4 = factor*jibal_stop_kernel_stop(kernel, E + h * k3);
         E += (h / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
 #else
-        E += factor*h*jibal_stop(workspace, incident, layer->material, E);
+        E += factor*h*jibal_stop_kernel_stop(kernel, E);
 #endif
-        if(!isnormal(E))
+        if(!isnormal(E)) {
+            E = 0.0;
+            break;
+        }
+    }
+    jibal_stop_kernel_free(kernel);
+    return E;
+}
+
+static double stop_layer_energy_loss_adaptive(jibal_gsto *workspace, const jibal_layer *layer, jibal_stop_kernel *kernel, double E_0, double factor, double rtol, double *S, size_t *n_steps) {
+    /* Embedded Runge-Kutta (Dormand-Prince 5(4)) with step size control. The local error estimate is compared to
+     * rtol*|E| (plus a small absolute tolerance, so that an ion that is stopping doesn't force infinitely small steps).
+     * The last stage of a step is the first stage of the next one, so an accepted step costs six evaluations of
+     * stopping. If S is not NULL, straggling is accumulated as in jibal_layer_energy_loss_with_straggling(). */
+    const double a21 = 1.0/5.0;
+    const double a31 = 3.0/40.0, a32 = 9.0/40.0;
+    const double a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+    const double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0, a53 = 64448.0/6561.0, a54 = -212.0/729.0;
+    const double a61 = 9017.0/3168.0, a62 = -355.0/33.0, a63 = 46732.0/5247.0, a64 = 49.0/176.0, a65 = -5103.0/18656.0;
+    const double b1 = 35.0/384.0, b3 = 500.0/1113.0, b4 = 125.0/192.0, b5 = -2187.0/6784.0, b6 = 11.0/84.0;
+    const double e1 = 71.0/57600.0, e3 = -71.0/16695.0, e4 = 71.0/1920.0, e5 = -17253.0/339200.0, e6 = 22.0/525.0, e7 = -1.0/40.0;
+    const double atol = rtol * JIBAL_STOP_ADAPTIVE_ATOL;
+    double E = E_0;
+    double x = 0.0;
+    double h = workspace->stop_step;
+    size_t n = 0;
+    if(n_steps) {
+        *n_steps = 0;
+    }
+    if(rtol <= 0.0 || h <= 0.0) {
+        return 0.0;
+    }
+    jibal_stop_kernel_result r;
+    jibal_stop_kernel_eval(kernel, E, &r);
+    double k1 = factor*r.S;
+    double stragg = r.stragg;
+    while(layer->thickness - x > workspace->stop_step/1e6) {
+        if(x + h > layer->thickness) { /* Last step may be partial */
+            h = layer->thickness - x;
+        }
+        double k2 = factor*jibal_stop_kernel_stop(kernel, E + h*(a21*k1));
+        double k3 = factor*jibal_stop_kernel_stop(kernel, E + h*(a31*k1 + a32*k2));
+        double k4 = factor*jibal_stop_kernel_stop(kernel, E + h*(a41*k1 + a42*k2 + a43*k3));
+        double k5 = factor*jibal_stop_kernel_stop(kernel, E + h*(a51*k1 + a52*k2 + a53*k3 + a54*k4));
+        double k6 = factor*jibal_stop_kernel_stop(kernel, E + h*(a61*k1 + a62*k2 + a63*k3 + a64*k4 + a65*k5));
+        double E_new = E + h*(b1*k1 + b3*k3 + b4*k4 + b5*k5 + b6*k6);
+        if(!isnormal(E_new)) {
             return 0.0;
+        }
+        jibal_stop_kernel_eval(kernel, E_new, &r);
+        double k7 = factor*r.S;
+        double err = fabs(h*(e1*k1 + e3*k3 + e4*k4 + e5*k5 + e6*k6 + e7*k7)) / (rtol*fmax(fabs(E), fabs(E_new)) + atol);
+        double scale = (err > 0.0) ? 0.9*pow(err, -0.2) : 5.0; /* New step size from error estimate, limited below */
+        if(scale > 5.0) {
+            scale = 5.0;
+        } else if(scale < 0.2) {
+            scale = 0.2;
+        }
+        n++;
+        if(n > JIBAL_STOP_ADAPTIVE_MAX_STEPS) {
+            fprintf(stderr, "Adaptive energy loss calculation did not converge in %i steps (E = %g keV).\n", JIBAL_STOP_ADAPTIVE_MAX_STEPS, E/C_KEV);
+            return 0.0;
+        }
+        if(err > 1.0) { /* Reject, try again with a smaller step */
+            h *= scale;
+            continue;
+        }
+        if(S) { /* Steps can be long, so straggling is integrated with Simpson's rule. Straggling generated at x is weighted by (S(E_new)/S(E(x)))^2 (non-statistical broadening). */
+            double stragg_new = r.stragg;
+            jibal_stop_kernel_result mid;
+            jibal_stop_kernel_eval(kernel, (E + E_new)/2.0, &mid);
+            double stragg_mid = mid.stragg;
+#ifndef NO_NON_STATISTICAL_BROADENING
+            double k_mid = factor*mid.S;
+            double r1 = k7/k1, r_mid = k7/k_mid; /* Ratios of stopping */
+            *S *= r1*r1;
+            *S += (h/6.0)*(stragg*r1*r1 + 4.0*stragg_mid*r_mid*r_mid + stragg_new);
+#else
+            *S += (h/6.0)*(stragg + 4.0*stragg_mid + stragg_new);
+#endif
+            stragg = stragg_new;
+        }
+        x += h;
+        E = E_new;
+        k1 = k7;
+        h *= scale;
+        if(n_steps) {
+            (*n_steps)++;
+        }
     }
+#ifdef DEBUG
+    fprintf(stderr, "Adaptive energy loss: thickness %g tfu, %zu steps (%zu accepted), E = %.3lf keV => %.3lf keV\n", layer->thickness/C_TFU, n, n_steps ? *n_steps : 0, E_0/C_KEV, E/C_KEV);
+#endif
+    return E;
+}
+
+double jibal_layer_energy_loss_adaptive(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_layer *layer, double E_0, double factor, double rtol, double *S, size_t *n_steps) {
+    jibal_stop_kernel *kernel = jibal_stop_kernel_new(workspace, incident, layer->material);
+    double E = stop_layer_energy_loss_adaptive(workspace, layer, kernel, E_0, factor, rtol, S, n_steps);
+    jibal_stop_kernel_free(kernel);
     return E;
 }
 
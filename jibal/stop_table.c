@@ -0,0 +1,225 @@
+/*
+    Jyväskylä Ion Beam Analysis Library (JIBAL)
+    Copyright (C) 2020 - 2026 Jaakko Julin <jaakko.julin@jyu.fi>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <jibal_stop.h>
+#include <jibal_stop_table.h>
+
+jibal_stop_table *jibal_stop_table_new(jibal_gsto *workspace, const jibal_isotope *incident, const jibal_material *target, size_t n) {
+    if(!workspace || !incident || !target || target->n_elements == 0) {
+        return NULL;
+    }
+    size_t i;
+    double em_min = 0.0, em_max = 0.0;
+    int common_grid = TRUE; /* All files share the same log10 grid */
+    size_t xpoints = 0; /* Of the first file */
+    for(i = 0; i < target->n_elements; i++) {
+        const gsto_file_t *file = jibal_gsto_get_loaded_file(workspace, GSTO_STO_ELE, incident->Z, target->elements[i].Z);
+        if(!file) {
+            fprintf(stderr, "Can not make a stopping table for %s in %s, stopping for Z2 = %i is not assigned or loaded.\n",
+                    incident->name, target->name, target->elements[i].Z);
+            return NULL;
+        }
+        double lo = file->em[0];
+        double hi = file->em[file->xpoints - 1];
+        if(file->xscale != GSTO_XSCALE_LOG10) {
+            common_grid = FALSE;
+        }
+        if(i == 0) {
+            xpoints = file->xpoints;
+            em_min = lo;
+            em_max = hi;
+            continue;
+        }
+        if(file->xpoints != xpoints || lo != em_min || hi != em_max) {
+            common_grid = FALSE;
+        }
+        if(lo < em_min)
+            em_min = lo;
+        if(hi > em_max)
+            em_max = hi;
+    }
+    if(em_min <= 0.0 || em_max <= em_min) {
+        fprintf(stderr, "Can not make a stopping table for %s in %s, energy range of stopping files is not valid.\n",
+                incident->name, target->name);
+        return NULL;
+    }
+    if(n == 0) { /* When all files share a grid, the original points are also points of the table. Linear interpolation of electronic stopping is then exact. */
+        n = common_grid ? JIBAL_STOP_TABLE_OVERSAMPLING * (xpoints - 1) + 1 : JIBAL_STOP_TABLE_XPOINTS;
+    }
+    if(n < 2) {
+        return NULL;
+    }
+    jibal_stop_table *table = malloc(sizeof(jibal_stop_table));
+    table->incident = incident;
+    table->n = n;
+    table->E_min = em_min * incident->mass;
+    table->E_max = em_max * incident->mass;
+    table->log_E_min = log10(table->E_min);
+    table->div = (n - 1) / (log10(table->E_max) - table->log_E_min);
+    table->stop_step = workspace->stop_step;
+    table->extrapolate = workspace->extrapolate;
+    table->E = malloc(sizeof(double) * n);
+    table->S = malloc(sizeof(double) * n);
+    table->stragg = NULL;
+    table->S_ele_min = 0.0;
+    table->S_ele_max = 0.0;
+    table->nuc = jibal_stop_nuc_ctx_new(incident, target, JIBAL_STOP_NUC_ISOTOPES);
+    double *em = malloc(sizeof(double) * n);
+    double *S_ele = malloc(sizeof(double) * n);
+    for(i = 0; i < n; i++) {
+        double E = table->E_min * pow(table->E_max / table->E_min, 1.0 * i / (1.0 * (n - 1)));
+        if(i == n - 1) {
+            E = table->E_max; /* Avoid floating point issues at the end */
+        }
+        table->E[i] = E;
+        em[i] = E / incident->mass;
+        table->S[i] = jibal_stop_nuc_ctx_get(table->nuc, E);
+    }
+    size_t i_elem;
+    for(i_elem = 0; i_elem < target->n_elements; i_elem++) { /* Electronic stopping, one element at a time */
+        if(!jibal_gsto_get_em_many(workspace, GSTO_STO_ELE, incident->Z, target->elements[i_elem].Z, em, S_ele, n)) {
+            fprintf(stderr, "Can not make a stopping table for %s in %s, stopping for Z2 = %i is not available.\n",
+                    incident->name, target->name, target->elements[i_elem].Z);
+            goto error;
+        }
+        for(i = 0; i < n; i++) {
+            table->S[i] += target->concs[i_elem] * S_ele[i];
+        }
+        table->S_ele_min += target->concs[i_elem] * S_ele[0];
+        table->S_ele_max += target->concs[i_elem] * S_ele[n - 1];
+    }
+    for(i_elem = 0; i_elem < target->n_elements; i_elem++) { /* Straggling is optional */
+        if(!jibal_gsto_get_loaded_file(workspace, GSTO_STO_STRAGG, incident->Z, target->elements[i_elem].Z)) {
+            break;
+        }
+    }
+    if(i_elem == target->n_elements) {
+        table->stragg = calloc(n, sizeof(double));
+        for(i_elem = 0; i_elem < target->n_elements; i_elem++) {
+            if(!jibal_gsto_get_em_many(workspace, GSTO_STO_STRAGG, incident->Z, target->elements[i_elem].Z, em, S_ele, n)) {
+                fprintf(stderr, "Can not make a stopping table for %s in %s, straggling for Z2 = %i is not available.\n",
+                        incident->name, target->name, target->elements[i_elem].Z);
+                goto error;
+            }
+            for(i = 0; i < n; i++) {
+                table->stragg[i] += target->concs[i_elem] * S_ele[i];
+            }
+        }
+    }
+    free(em);
+    free(S_ele);
+#ifdef DEBUG
+    fprintf(stderr, "Stopping table for %s in %s: %zu points (%s), E = %g keV ... %g keV\n", incident->name, target->name,
+            n, common_grid ? "common grid" : "resampled", table->E_min / C_KEV, table->E_max / C_KEV);
+#endif
+    return table;
+error:
+    free(em);
+    free(S_ele);
+    jibal_stop_table_free(table);
+    return NULL;
+}
+
+void jibal_stop_table_free(jibal_stop_table *table) {
+    if(!table) {
+        return;
+    }
+    free(table->E);
+    free(table->S);
+    free(table->stragg);
+    jibal_stop_nuc_ctx_free(table->nuc);
+    free(table);
+}
+
+int jibal_stop_table_index(const jibal_stop_table *table, double E) {
+    if(!(E >= table->E_min && E <= table->E_max)) { /* Also catches NaN */
+        return -1;
+    }
+    size_t lo = floor((log10(E) - table->log_E_min) * table->div);
+    if(lo >= table->n - 1) { /* E == E_max or floating point issues */
+        lo = table->n - 2;
+    }
+    return lo;
+}
+
+double jibal_stop_table_get(const jibal_stop_table *table, double E) {
+    int lo = jibal_stop_table_index(table, E);
+    if(lo < 0) { /* Out of bounds. Electronic stopping follows the same rules as jibal_gsto_get_em(), nuclear stopping is calculated as in jibal_stop(). */
+        if(!(E >= 0.0)) {
+            return 0.0;
+        }
+        double S = jibal_stop_nuc_ctx_get(table->nuc, E);
+        if(table->extrapolate) {
+            if(E <= table->E_min) {
+                S += jibal_linear_interpolation(0.0, table->E_min, 0.0, table->S_ele_min, E);
+            } else {
+                S += table->S_ele_max;
+            }
+        }
+        return S;
+    }
+    return jibal_linear_interpolation(table->E[lo], table->E[lo + 1], table->S[lo], table->S[lo + 1], E);
+}
+
+double jibal_stop_table_get_stragg(const jibal_stop_table *table, double E) {
+    if(!table->stragg) {
+        return 0.0;
+    }
+    int lo = jibal_stop_table_index(table, E);
+    if(lo < 0) {
+        if(table->extrapolate) {
+            if(E >= 0.0 && E <= table->E_min) {
+                return jibal_linear_interpolation(0.0, table->E_min, 0.0, table->stragg[0], E);
+            }
+            if(E >= table->E_max) {
+                return table->stragg[table->n - 1];
+            }
+        }
+        return 0.0;
+    }
+    return jibal_linear_interpolation(table->E[lo], table->E[lo + 1], table->stragg[lo], table->stragg[lo + 1], E);
+}
+
+double jibal_stop_table_layer_energy_loss(const jibal_stop_table *table, double thickness, double E_0, double factor) {
+    double E = E_0;
+    double x;
+    double h = table->stop_step;
+    for (x = 0.0; x <= thickness; x += h) {
+        if(x+h > thickness) { /* Last step may be partial */
+            h = thickness - x;
+            if(h < table->stop_step/1e6) {
+                break;
+            }
+        }
+#ifndef NO_RUNGE_KUTTA
+        double k1, k2, k3, k4;
+        k1 = factor*jibal_stop_table_get(table, E);
+        k2 = factor*jibal_stop_table_get(table, E + (h / 2) * k1);
+        k3 = factor*jibal_stop_table_get(table, E + (h / 2) * k2);
+        k4 = factor*jibal_stop_table_get(table, E + h * k3);
+        E += (h / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
+#else
+        E += factor*h*jibal_stop_table_get(table, E);
+#endif
+        if(!isnormal(E))
+            return 0.0;
+    }
+    return E;
+}
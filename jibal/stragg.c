@@ -20,9 +20,15 @@ double jibal_layer_energy_loss_with_straggling(jibal_gsto *workspace, const jiba
     double dE;
     double x;
     double h = workspace->stop_step;
+    if(workspace->stop_tolerance > 0.0) {
+        return jibal_layer_energy_loss_adaptive(workspace, incident, layer, E_0, factor, workspace->stop_tolerance, S, NULL);
+    }
 #ifdef DEBUG
     fprintf(stderr, "Thickness %g, stop step %g\n", layer->thickness, h);
 #endif
+    jibal_stop_kernel *kernel = jibal_stop_kernel_new(workspace, incident, layer->material);
+    jibal_stop_kernel_result r; /* Stopping and straggling at E. The evaluation at the end of a step is the first one of the next step. */
+    jibal_stop_kernel_eval(kernel, E, &r);
     for (x = 0.0; x <= layer->thickness; x += h) {
         if(x+h > layer->thickness) { /* Last step may be partial */
             h=layer->thickness-x;
@@ -32,24 +38,31 @@ double jibal_layer_energy_loss_with_straggling(jibal_gsto *workspace, const jiba
         }
 #ifndef NO_RUNGE_KUTTA
         double k1, k2, k3, k4;
-        k1 = factor*jibal_stop(workspace, incident, layer->material, E);
-        k2 = factor*jibal_stop(workspace, incident, layer->material, E + (h / 2) * k1);
-        k3 = factor*jibal_stop(workspace, incident, layer->material, E + (h / 2) * k2);
-        k4 = factor*jibal_stop(workspace, incident, layer->material, E + h * k3);
+        k1 = factor*r.S;
+        k2 = factor*jibal_stop_kernel_stop(kernel, E + (h / 2) * k1);
+        k3 = factor*jibal_stop_kernel_stop(kernel, E + (h / 2) * k2);
+        k4 = factor*jibal_stop_kernel_stop(kernel, E + h * k3);
         dE = (h / 6) * (k1 + 2 * k2 + 2 * k3 + k4); /* Energy change in thickness "h" */
+        double stragg_mid = jibal_stop_kernel_stragg(kernel, E + dE/2.0); /* Straggling, calculate at mid-energy */
+        double S_prev = r.S;
+        jibal_stop_kernel_eval(kernel, E + dE, &r);
 #ifndef NO_NON_STATISTICAL_BROADENING
-        double s_ratio = jibal_stop(workspace, incident, layer->material, E+dE)/(k1/factor); /* Ratio of stopping */
+        double s_ratio = r.S/S_prev; /* Ratio of stopping */
         *S *= (s_ratio)*(s_ratio); /* Non-statistical broadening due to energy dependent stopping */
 #endif
-        *S += h*jibal_stragg(workspace, incident, layer->material, (E+dE/2)); /* Straggling, calculate at mid-energy */
+        *S += h*stragg_mid;
         E += dE;
 #else
-        dE = factor*h*jibal_stop(workspace, incident, layer->material, E);
-        E += factor*h*jibal_stop(workspace, incident, layer->material, E);
+        dE = factor*h*r.S;
+        E += dE;
+        jibal_stop_kernel_eval(kernel, E, &r);
         /* TODO: straggling? */
 #endif
-        if(!isnormal(E))
-            return 0.0;
+        if(!isnormal(E)) {
+            E = 0.0;
+            break;
+        }
     }
+    jibal_stop_kernel_free(kernel);
     return E;
 }
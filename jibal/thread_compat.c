@@ -0,0 +1,90 @@
+#ifndef WIN32
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+#include <time.h>
+#endif
+#include <stdlib.h>
+#include "thread_compat.h"
+
+jibal_mutex *jibal_mutex_new(void) {
+    jibal_mutex *mutex = malloc(sizeof(jibal_mutex));
+#ifdef WIN32
+    InitializeCriticalSection(mutex);
+#else
+    if(pthread_mutex_init(mutex, NULL)) {
+        free(mutex);
+        return NULL;
+    }
+#endif
+    return mutex;
+}
+
+void jibal_mutex_free(jibal_mutex *mutex) {
+    if(!mutex) {
+        return;
+    }
+#ifdef WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+    free(mutex);
+}
+
+void jibal_mutex_lock(jibal_mutex *mutex) {
+#ifdef WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void jibal_mutex_unlock(jibal_mutex *mutex) {
+#ifdef WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+#ifdef WIN32
+static DWORD WINAPI jibal_thread_wrapper(LPVOID arg) {
+#else
+static void *jibal_thread_wrapper(void *arg) {
+#endif
+    jibal_thread *thread = arg;
+    thread->func(thread->arg);
+    return 0;
+}
+
+int jibal_thread_start(jibal_thread *thread, void (*func)(void *), void *arg) {
+    thread->func = func;
+    thread->arg = arg;
+#ifdef WIN32
+    thread->handle = CreateThread(NULL, 0, jibal_thread_wrapper, thread, 0, NULL);
+    return thread->handle != NULL;
+#else
+    return pthread_create(&thread->thread, NULL, jibal_thread_wrapper, thread) == 0;
+#endif
+}
+
+void jibal_thread_join(jibal_thread *thread) {
+#ifdef WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->thread, NULL);
+#endif
+}
+
+double jibal_time(void) {
+#ifdef WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
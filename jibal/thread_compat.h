@@ -0,0 +1,54 @@
+#ifndef THREAD_COMPAT_H
+#define THREAD_COMPAT_H
+/* Minimal portable mutexes and atomic pointers. For internal use only. */
+#ifdef WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION jibal_mutex;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t jibal_mutex;
+#endif
+
+typedef struct jibal_thread {
+#ifdef WIN32
+    HANDLE handle;
+#else
+    pthread_t thread;
+#endif
+    void (*func)(void *);
+    void *arg;
+} jibal_thread;
+
+jibal_mutex *jibal_mutex_new(void);
+void jibal_mutex_free(jibal_mutex *mutex);
+void jibal_mutex_lock(jibal_mutex *mutex);
+void jibal_mutex_unlock(jibal_mutex *mutex);
+int jibal_thread_start(jibal_thread *thread, void (*func)(void *), void *arg); /* Runs func(arg) in a new thread. thread must stay valid until jibal_thread_join(). Returns 0 on failure. */
+void jibal_thread_join(jibal_thread *thread);
+double jibal_time(void); /* Monotonic wall clock time in seconds, for measuring intervals */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define jibal_atomic_load_ptr(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define jibal_atomic_store_ptr(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define jibal_atomic_cas_ptr(p, expected, v) jibal_atomic_cas_ptr_gcc((void **)(p), (expected), (v))
+static inline int jibal_atomic_cas_ptr_gcc(void **p, void *expected, void *v) {
+    return __atomic_compare_exchange_n(p, &expected, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#define jibal_atomic_add_size(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define jibal_atomic_load_size(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define jibal_atomic_store_size(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define jibal_atomic_load_size_seq(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define jibal_atomic_store_size_seq(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#else /* MSVC, volatile accesses have acquire/release semantics */
+#define jibal_atomic_load_ptr(p) (*(void * volatile *)(p))
+#define jibal_atomic_store_ptr(p, v) (*(void * volatile *)(p) = (v))
+#define jibal_atomic_cas_ptr(p, expected, v) (InterlockedCompareExchangePointer((void * volatile *)(p), (v), (expected)) == (expected))
+#define jibal_atomic_add_size(p, v) (InterlockedExchangeAddSizeT((p), (v)) + (v))
+#define jibal_atomic_load_size(p) (*(volatile size_t *)(p))
+#define jibal_atomic_store_size(p, v) (*(volatile size_t *)(p) = (v))
+#define jibal_atomic_load_size_seq(p) (MemoryBarrier(), *(volatile size_t *)(p))
+#define jibal_atomic_store_size_seq(p, v) do { *(volatile size_t *)(p) = (v); MemoryBarrier(); } while(0)
+#endif
+/* Counters (size_t) are relaxed, jibal_atomic_add_size(p, v) returns the new value. The _seq variants are sequentially consistent. */
+/* jibal_atomic_cas_ptr(p, expected, v) sets *p = v if *p == expected, returns TRUE (nonzero) if it did. */
+#endif // THREAD_COMPAT_H
@@ -20,8 +20,145 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <jibal_units.h>
 
+#define UNITS_SI_PREFIXES "YZEPTGMkhdcmunpfazy"
+
+typedef struct units_table_entry {
+    char *name; /* Unit with prefix, e.g. "keV". NULL if the slot is free. */
+    jibal_unit_type type; /* JIBAL_UNIT_TYPE_ANY for entries matching any type */
+    double f;
+} units_table_entry;
+
+typedef struct units_table { /* See jibal_units_compile() */
+    size_t mask; /* Size of entries minus one, size is a power of two */
+    size_t n;
+    units_table_entry *entries; /* Open addressing, linear probing */
+} units_table;
+
+static double units_si_prefix(char c) { /* Factor of SI prefix c, 0.0 if c is not a prefix */
+    switch(c) {
+        case 'Y':
+            return 1e22;
+        case 'Z':
+            return 1e21;
+        case 'E':
+            return 1e18;
+        case 'P':
+            return 1e15;
+        case 'T':
+            return 1e12;
+        case 'G':
+            return 1e9;
+        case 'M':
+            return 1e6;
+        case 'k':
+            return 1e3;
+        case 'h':
+            return 1e2;
+        /* deca is not supported, since we would need two letters "da" for it */
+        case 'd':
+            return 1e-1;
+        case 'c':
+            return 1e-2;
+        case 'm':
+            return 1e-3;
+        case 'u':
+            return 1e-6;
+        case 'n':
+            return 1e-9;
+        case 'p':
+            return 1e-12;
+        case 'f':
+            return 1e-15;
+        case 'a':
+            return 1e-18;
+        case 'z':
+            return 1e-21;
+        case 'y':
+            return 1e-24;
+        default:
+            return 0.0;
+    }
+}
+
+static size_t units_hash(jibal_unit_type type, const char *name) { /* FNV-1a */
+    uint32_t h = 2166136261u ^ (unsigned char)type;
+    h *= 16777619u;
+    for(; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static units_table_entry *units_table_slot(const units_table *table, jibal_unit_type type, const char *name) { /* Slot of name or the free slot where it should go */
+    size_t i;
+    for(i = units_hash(type, name) & table->mask; table->entries[i].name; i = (i + 1) & table->mask) {
+        if(table->entries[i].type == type && strcmp(table->entries[i].name, name) == 0) {
+            break;
+        }
+    }
+    return &table->entries[i];
+}
+
+static void units_table_add(units_table *table, jibal_unit_type type, const char *prefix, const char *name, double f) {
+    /* Units are added in the order of the list and the first one wins, like in a linear search */
+    char *full = malloc(strlen(prefix) + strlen(name) + 1);
+    strcpy(full, prefix);
+    strcat(full, name);
+    units_table_entry *entry = units_table_slot(table, type, full);
+    if(entry->name) {
+        free(full);
+        return;
+    }
+    entry->name = full;
+    entry->type = type;
+    entry->f = f;
+    table->n++;
+}
+
+static void units_table_free(units_table *table) {
+    if(!table)
+        return;
+    size_t i;
+    for(i = 0; i <= table->mask; i++) {
+        free(table->entries[i].name);
+    }
+    free(table->entries);
+    free(table);
+}
+
+int jibal_units_compile(jibal_units *units) {
+    if(!units)
+        return 0;
+    units_table_free(units->table);
+    units->table = NULL;
+    size_t n = 2 * (strlen(UNITS_SI_PREFIXES) + 1) * jibal_units_count(units); /* Each unit, with and without prefixes, for its own type and for any type */
+    units_table *table = malloc(sizeof(units_table));
+    size_t size = 16;
+    while(size < 2 * n) {
+        size *= 2;
+    }
+    table->mask = size - 1;
+    table->n = 0;
+    table->entries = calloc(size, sizeof(units_table_entry));
+    const jibal_units *u;
+    for(u = units; u; u = u->next) {
+        const char *c;
+        units_table_add(table, u->type, "", u->name, u->f);
+        units_table_add(table, JIBAL_UNIT_TYPE_ANY, "", u->name, u->f);
+        for(c = UNITS_SI_PREFIXES; *c; c++) {
+            char prefix[2] = {*c, '\0'};
+            units_table_add(table, u->type, prefix, u->name, u->f * units_si_prefix(*c));
+            units_table_add(table, JIBAL_UNIT_TYPE_ANY, prefix, u->name, u->f * units_si_prefix(*c));
+        }
+    }
+    units->table = table;
+    return (int)table->n;
+}
+
 jibal_units *jibal_units_add(jibal_units *units, double f, char type, char *name) {
     jibal_units *first=units;
     jibal_units *this=malloc(sizeof(jibal_units));
@@ -29,6 +166,7 @@ jibal_units *jibal_units_add(jibal_units *units, double f, char type, char *name
     this->type = type;
     this->next = NULL;
     this->name=name;
+    this->table = NULL;
     if(!first) {
         return this;
     }
@@ -36,6 +174,9 @@ jibal_units *jibal_units_add(jibal_units *units, double f, char type, char *name
         units=units->next;
     }
     units->next=this;
+    if(first->table) {
+        jibal_units_compile(first);
+    }
     return first;
 }
 
@@ -59,6 +200,7 @@ jibal_units *jibal_units_default(void) {
     units=jibal_units_add(units, 1.0, JIBAL_UNIT_TYPE_SOLID_ANGLE, "sr");
     units=jibal_units_add(units, 1.0e-3, JIBAL_UNIT_TYPE_DENSITY, "g/m3"); /* We should probably parse units better to avoid units like these */
     units=jibal_units_add(units, 1000.0, JIBAL_UNIT_TYPE_DENSITY, "g/cm3"); /* We should probably parse units better to avoid units like these */
+    jibal_units_compile(units);
     return units;
 }
 
@@ -107,6 +249,10 @@ double jibal_units_get(const jibal_units *units, jibal_unit_type type, const cha
     if(*name == '\0') { /* Empty, no unit, assume SI. */
         return 1.0;
     }
+    if(units && units->table) {
+        const units_table_entry *entry = units_table_slot(units->table, type, name);
+        return entry->name ? entry->f : nan("");
+    }
     while(units) {
         if(type && (units->type != type)) {
             units=units->next;
@@ -116,48 +262,9 @@ double jibal_units_get(const jibal_units *units, jibal_unit_type type, const cha
             return units->f; /* Exact match */
         }
         if(strcmp(units->name, name+1)==0) { /* Last letters match, first letter might be a SI prefix */
-            double f=units->f;
-            switch(*name) { /* First char */
-                case 'Y':
-                    return f*1e22;
-                case 'Z':
-                    return f*1e21;
-                case 'E':
-                    return f*1e18;
-                case 'P':
-                    return f*1e15;
-                case 'T':
-                    return f*1e12;
-                case 'G':
-                    return f*1e9;
-                case 'M':
-                    return f*1e6;
-                case 'k':
-                    return f*1e3;
-                case 'h':
-                    return f*1e2;
-                /* deca is not supported, since we would need two letters "da" for it */
-                case 'd':
-                    return f*1e-1;
-                case 'c':
-                    return f*1e-2;
-                case 'm':
-                    return f*1e-3;
-                case 'u':
-                    return f*1e-6;
-                case 'n':
-                    return f*1e-9;
-                case 'p':
-                    return f*1e-12;
-                case 'f':
-                    return f*1e-15;
-                case 'a':
-                    return f*1e-18;
-                case 'z':
-                    return f*1e-21;
-                case 'y':
-                    return f*1e-24;
-                /* No default case since we fall through */
+            double prefix = units_si_prefix(*name);
+            if(prefix != 0.0) {
+                return units->f * prefix;
             }
         }
         units=units->next;
@@ -230,6 +337,7 @@ const char *jibal_unit_conversion_error_string(int error) {
 void jibal_units_free(jibal_units *units) {
     if(!units)
         return;
+    units_table_free(units->table);
     jibal_units *this;
     this=units;
     while(this != NULL) {
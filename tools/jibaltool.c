@@ -10,6 +10,7 @@
 #include <jibal_defaults.h>
 #include <jibal_cs.h>
 #include <jibal_kin.h>
+#include <jibal_scattering.h>
 
 #ifdef WIN32
 #include <jibal_registry.h>
@@ -174,7 +175,7 @@ int extract(jibaltool_global *global, int argc, char **argv) {
         fprintf(stderr, "Usage: jibaltool --stopfile=<stopfile> [--format=<format>] extract incident target "
                         "[incident high] [target high]\n\n\tIncident and targets are elements (e.g. He or Si).\n\tYou "
                         "can give a range of incident elements too.\n\n\tExample: jibaltool --stopfile=srim2013 "
-                        "extract He H He U\n");
+                        "extract He H He U\n\n\tFormat can be \"ascii\" (default), \"bin\" or \"container\" (memory mappable, requires --out).\n");
         return -1;
     }
     jibal *jibal = global->jibal;
@@ -229,6 +230,9 @@ int extract(jibaltool_global *global, int argc, char **argv) {
     if(global->format && strcmp(global->format, "bin")==0) {
         format=GSTO_DF_DOUBLE;
     }
+    if(global->format && strcmp(global->format, "container")==0) {
+        format=GSTO_DF_CONTAINER;
+    }
     jibal_gsto_fprint_file(out, jibal->gsto, file, format, Z1_low, Z1_high, Z2_low, Z2_high);
     jibaltool_close_output(out);
     return 0;
@@ -350,36 +354,30 @@ int print_cs(jibaltool_global *global, int argc, char **argv) {
     double theta = jibal_get_val(jibal->units, JIBAL_UNIT_TYPE_ANGLE, argv[2]);
     double E = jibal_get_val(jibal->units, JIBAL_UNIT_TYPE_ENERGY, argv[3]);
 
-    double cs_rbs = 0.0, cs_rbs_rutherford = 0.0;
-    double cs_erd = 0.0, cs_erd_rutherford = 0.0;
-    int erd = theta < (90.0*C_DEG);
-    for(size_t i_elem = 0; i_elem < target_material->n_elements; i_elem++) {
-        jibal_element *e = &target_material->elements[i_elem];
-        for(size_t i_isotope = 0; i_isotope < e->n_isotopes; i_isotope++) {
-            const jibal_isotope *isotope = e->isotopes[i_elem];
-            double theta_max=asin(isotope->mass/incident->mass);
-
-            double c = e->concs[i_isotope];
-            if(!(incident->mass > isotope->mass && theta > theta_max)) { /* Scattering possible */
-                double sigma_rbs = jibal_cs_rbs(jibal->config, incident, isotope, theta, E);
-                cs_rbs += c * sigma_rbs;
-                cs_rbs_rutherford += c * jibal_cross_section_rbs(incident, isotope, theta, E, JIBAL_CS_RUTHERFORD);
-            }
-            if(erd) {
-                double sigma_erd = jibal_cs_erd(jibal->config, incident, isotope, theta, E);
-                cs_erd += c * sigma_erd;
-                cs_erd_rutherford += c * jibal_cross_section_erd(incident, isotope, theta, E, JIBAL_CS_RUTHERFORD);
-            }
-#ifdef DEBUG
-            fprintf(stderr, "Isotope %zu conc %lf\n", i_isotope, e->concs[i_isotope]);
-#endif
-        }
+    jibal_scattering *s = jibal_scattering_new(incident, target_material, theta, jibal->config->cs_rbs, jibal->config->cs_erd);
+    jibal_scattering *s_rutherford = jibal_scattering_new(incident, target_material, theta, JIBAL_CS_RUTHERFORD, JIBAL_CS_RUTHERFORD);
+    jibal_material_free(target_material);
+    if(!s || !s_rutherford) {
+        fprintf(stderr, "Could not compute cross sections.\n");
+        jibal_scattering_free(s);
+        jibal_scattering_free(s_rutherford);
+        return EXIT_FAILURE;
     }
+    double cs_rbs = jibal_scattering_rbs(s, E, NULL);
+    double cs_rbs_rutherford = jibal_scattering_rbs(s_rutherford, E, NULL);
     fprintf(stderr, "RBS cross section is %g mb/sr (%s). Ratio to Rutherford: %.5lf\n", cs_rbs/C_MB_SR, jibal_cs_rbs_name(jibal->config), cs_rbs/cs_rbs_rutherford);
-    if(erd) {
+    if(s->erd) {
+        double cs_erd = jibal_scattering_erd(s, E, NULL);
+        double cs_erd_rutherford = jibal_scattering_erd(s_rutherford, E, NULL);
         fprintf(stderr, "ERD cross section is %g mb/sr (%s). Ratio to Rutherford: %.5lf\n", cs_erd / C_MB_SR, jibal_cs_erd_name(jibal->config), cs_erd/cs_erd_rutherford);
     }
-    jibal_material_free(target_material);
+#ifdef DEBUG
+    for(size_t i = 0; i < s->n_isotopes; i++) {
+        fprintf(stderr, "Isotope %s conc %lf\n", s->isotopes[i]->name, s->conc[i]);
+    }
+#endif
+    jibal_scattering_free(s);
+    jibal_scattering_free(s_rutherford);
     return EXIT_SUCCESS;
 }
 
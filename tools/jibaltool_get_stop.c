@@ -22,6 +22,7 @@
 #include <jibal.h>
 #include <jibal_stop.h>
 #include <jibal_stragg.h>
+#include <jibal_layer_stack.h>
 #include <jibal_defaults.h>
 #ifdef WIN32
 #include <win_compat.h>
@@ -169,9 +170,14 @@ int print_stop(jibaltool_global *global, int argc, char **argv) {
         fprintf(stderr, "E = %g keV\n", E/C_KEV);
         double S=0.0;
         double E_0=E;
-        for(i=0; i < g.n_layers; i++) {
-            E = jibal_layer_energy_loss_with_straggling(jibal->gsto, g.incident, g.target[i], E, -1.0, &S);
+        jibal_layer_stack *stack = jibal_layer_stack_new(jibal->gsto, g.incident, g.target, g.n_layers, E_0, -1.0);
+        if(!stack) {
+            fprintf(stderr, "Could not create layer stack.\n");
+            jibal_free(jibal);
+            return EXIT_FAILURE;
         }
+        E = jibal_layer_stack_exit_energy(stack, &S);
+        jibal_layer_stack_free(stack);
         fprintf(stdout, "E_out = %g keV\n", E/C_KEV);
         fprintf(stdout, "delta E = %g keV\n", (E-E_0)/C_KEV);
         fprintf(stdout, "Straggling = %g keV (FWHM)\n", C_FWHM*sqrt(S)/C_KEV);